@@ -1,83 +1,711 @@
 #include "bscta.h"
-#include "libta_math.h"
 
 
 #include <algorithm>
+#include <chrono>
+#include <limits>
+#include <mutex>
 #include <numeric>
+#include <system_error>
+#include <thread>
 
 namespace libta {
 
-template <typename T>
-std::shared_ptr<Response> BSCTimingAnalyzer<T>::perform_analysis(std::shared_ptr<Request<T>> req) {
+namespace {
 
-    //Copy in vector and sort it
-	auto trace_sorted = req->get_all();
+/**
+ * @brief Measure the wall time of consecutive phases
+ *
+ * enter() closes the current phase (if any) and opens the next one, stop() closes the current
+ * phase. The time (and, with LIBTA_PERF, the hardware counters) is added to the given statistics.
+ * Without LIBTA_STATS all the methods are no-ops. The class is local to this translation unit,
+ * since its definition depends on the macros.
+ */
+class PhaseClock {
 
-	if(trace_sorted.size() <= 10) {
+#ifdef LIBTA_STATS
+
+public:
+
+	explicit PhaseClock(AnalysisStats &stats) noexcept : stats(stats), current(-1) {}
+
+	~PhaseClock() {
+		stop();
+	}
+
+	inline void enter(phase_t phase) noexcept {
+		const auto now = std::chrono::steady_clock::now();
+		close(now);
+		this->current = static_cast<int>(phase);
+		this->start = now;
+#ifdef LIBTA_PERF
+		this->counting = PerfCounters::get().read(this->start_counters);
+#endif
+	}
+
+	inline void stop() noexcept {
+		close(std::chrono::steady_clock::now());
+		this->current = -1;
+	}
+
+	/** @brief True if the hardware counters are measured */
+	inline bool has_counters() const noexcept {
+#ifdef LIBTA_PERF
+		return PerfCounters::get().available();
+#else
+		return false;
+#endif
+	}
+
+private:
+	AnalysisStats &stats;
+	int current;
+	std::chrono::steady_clock::time_point start;
+#ifdef LIBTA_PERF
+	bool counting = false;
+	uint64_t start_counters[PerfCounters::COUNTERS];
+#endif
+
+	inline void close(std::chrono::steady_clock::time_point now) noexcept {
+		if(this->current < 0) {
+			return;
+		}
+#ifdef LIBTA_PERF
+		uint64_t values[PerfCounters::COUNTERS];
+		if(this->counting && PerfCounters::get().read(values)) {
+			for(int i = 0; i < PerfCounters::COUNTERS; i++) {
+				this->stats.counters[this->current][i] += values[i] - this->start_counters[i];
+			}
+		}
+#endif
+		this->stats.time_ns[this->current] += static_cast<uint64_t>(
+			std::chrono::duration_cast<std::chrono::nanoseconds>(now - this->start).count());
+	}
+
+#else
+
+public:
+
+	explicit PhaseClock(AnalysisStats &) noexcept {}
+
+	inline void enter(phase_t) noexcept {}
+	inline void stop() noexcept {}
+	inline bool has_counters() const noexcept { return false; }
+
+#endif
+
+};
+
+/**
+ * @brief Join the given threads when leaving the scope, also when unwinding
+ *
+ * A joinable std::thread that is destroyed calls std::terminate().
+ */
+class ThreadJoiner {
+
+public:
+
+	explicit ThreadJoiner(std::vector<std::thread> &threads) noexcept : threads(threads) {}
+
+	~ThreadJoiner() {
+		for(auto &t : threads) {
+			if(t.joinable()) {
+				t.join();
+			}
+		}
+	}
+
+private:
+	std::vector<std::thread> &threads;
+};
+
+}	// namespace
+
+template <typename T, typename Policy>
+constexpr int BSCTimingAnalyzer<T, Policy>::minvalues;
+
+template <typename T, typename Policy>
+constexpr int BSCTimingAnalyzer<T, Policy>::anytime_initial_window;
+
+template <typename T, typename Policy>
+std::shared_ptr<Response> BSCTimingAnalyzer<T, Policy>::perform_analysis(std::shared_ptr<Request<T>> req) {
+	return this->perform_analysis(req, AnalysisControl());
+}
+
+template <typename T, typename Policy>
+std::shared_ptr<Response> BSCTimingAnalyzer<T, Policy>::perform_analysis(std::shared_ptr<Request<T>> req,
+                                                                 const AnalysisControl &control) {
+	control.check();
+
+	uint64_t cache_key = 0;
+	if(this->cache) {
+		cache_key = hash_request(*req, this->get_configuration_hash());
+		EVTRecord record;
+		if(this->cache->load(cache_key, record) && record.has_bounds) {
+			return restore_from_cache(record, req->get_all().size());
+		}
+	}
+
+	BSCWorkspace<T> ws;
+	this->perform_analysis(*req, ws, control);
+
+	AnalysisStats stats;
+	PhaseClock clock(stats);
+	clock.enter(phase_t::RESPONSE);
+
+	auto gpd = std::make_shared <ResponseEVTDistribution> (ws.get_result());
+	set_bounds(ws);
+
+	clock.stop();
+	stats.bytes_allocated = 3 * sizeof(ResponseEVTDistribution);
+	thread_stats() += stats;
+
+	if(this->cache) {
+		store_to_cache(cache_key, ws.get_result(), ws.get_low_gpd(), ws.get_high_gpd());
+	}
+
+    return gpd;
+
+}
+
+template <typename T, typename Policy>
+void BSCTimingAnalyzer<T, Policy>::perform_analysis(const Request<T> &req, BSCWorkspace<T> &ws,
+                                            const AnalysisControl &control) const {
+	const auto &values = req.get_all();
+	this->perform_analysis(values.data(), values.size(), ws, control);
+}
+
+template <typename T, typename Policy>
+void BSCTimingAnalyzer<T, Policy>::analyze_trace(const void *values, size_t size, copy_t copy,
+                                         BSCWorkspace<T> &ws, const AnalysisControl &control) const {
+	control.check();
+
+	if(size <= 10) {
 		throw TimingAnalyzerError("The number of samples is '10' or less in the Request. "
-							      "Please get more samples.", error_t::INVALID_DATA);
+		                          "Please get more samples.", error_t::INVALID_DATA);
+	}
+
+	ws.stats.reset();
+	PhaseClock clock(ws.stats);
+	const size_t capacity = ws.capacity_bytes();
+	auto &trace_sorted = ws.trace;
+	const bool mixed = this->precision == precision_t::MIXED;
+
+	clock.enter(phase_t::COPY);
+	copy(values, size, ws, mixed);
+
+	clock.enter(phase_t::SORT);
+	if(mixed) {
+		std::sort(ws.bulk.begin(), ws.bulk.end(), std::greater<double>());
+	} else {
+		std::sort(trace_sorted.begin(),trace_sorted.end(), std::greater<T>() );
 	}
+	control.check();
 
-	std::sort(trace_sorted.begin(),trace_sorted.end(), std::greater<T>() );
-	
 	//Init Required stuff
-	const int file_size = trace_sorted.size();
+	const int file_size = mixed ? ws.bulk.size() : trace_sorted.size();
 	const int half_size = floor(file_size/2);
-	const int minvalues = 10;
 
-	std::vector<T> cv(half_size-2);
-	std::vector<T> limitabove(half_size-2);
+	clock.enter(phase_t::CV_SCAN);
+	const int nelems = mixed ? select_tail_size_mixed(ws.bulk, half_size, control)
+	                         : select_tail_size(trace_sorted, half_size, control);
+	control.check();
 
-	//Compute the CV = Coefficient of Variation. It is the std_dev/mean
-	//Need at lest 2 samples to compute the std_deviation
-	for(int rejectedSamples = 2; rejectedSamples < half_size; rejectedSamples++) {
-		int usedSamples=half_size - rejectedSamples;
-		T mean = getUnbiasedMean(trace_sorted,0,usedSamples);
-		T std_deviation = getUnbiasedStdDeviation(trace_sorted,0,usedSamples);
-		cv[rejectedSamples-2]= std_deviation/mean;
+	if(mixed) {
+		// Only the tail and the threshold are promoted to T for the fit
+		if(nelems < minvalues) {
+			throw_minvalues_error(nelems, file_size);
+		}
+		trace_sorted.assign(ws.bulk.begin(), ws.bulk.begin() + nelems + 1);
+	}
+
+	clock.enter(phase_t::GRID);
+	fit_tail(trace_sorted, nelems, ws, control);
+	ws.gpd.set_trace_usage(file_size, file_size, true);
+	clock.stop();
+
+	ws.stats.analyses = 1;
+	ws.stats.samples = file_size;
+	ws.stats.nelems = nelems;
+	ws.stats.counted = clock.has_counters() ? 1 : 0;
+	ws.stats.bytes_allocated = ws.capacity_bytes() - capacity;
+	thread_stats() += ws.stats;
+}
+
+template <typename T, typename Policy>
+void BSCTimingAnalyzer<T, Policy>::perform_analysis(const TailSummary<T> &summary, BSCWorkspace<T> &ws,
+                                            const AnalysisControl &control) const {
+	control.check();
+
+	if(summary.get_count() <= 10) {
+		throw TimingAnalyzerError("The number of samples is '10' or less in the Request. "
+							      "Please get more samples.", error_t::INVALID_DATA);
+	}
+
+	ws.stats.reset();
+	PhaseClock clock(ws.stats);
+	const size_t capacity = ws.capacity_bytes();
+
+	clock.enter(phase_t::SORT);
+	auto &trace_sorted = ws.trace;
+	summary.get_top(trace_sorted);
+	control.check();
+
+	// The CV scan of the whole trace would look at half of it at most
+	const uint64_t file_size = summary.get_count();
+	const int window = static_cast<int>(std::min<uint64_t>(trace_sorted.size(), file_size / 2));
+
+	clock.enter(phase_t::CV_SCAN);
+	const int nelems = select_tail_size(trace_sorted, window, control);
+	const bool complete = static_cast<uint64_t>(window) == file_size / 2 || nelems < window - 2;
+	control.check();
+
+	clock.enter(phase_t::GRID);
+	fit_tail(trace_sorted, nelems, ws, control);
+	if(! complete) {
+		// As in perform_anytime_analysis(), the scale is the largest excess mean that any longer
+		// tail could have. The lowest threshold the full scan can reach is the median of the
+		// trace, which is at most one standard deviation below the mean.
+		const double body = static_cast<double>(summary.get_body_count());
+		double sum = summary.get_body_mean() * body;
+		for(const T &v : trace_sorted) {
+			sum += static_cast<double>(v);
+		}
+		const double mean = sum / file_size;
+		double m2 = summary.get_body_variance() * std::max(body - 1, 0.)
+		          + body * (summary.get_body_mean() - mean) * (summary.get_body_mean() - mean);
+		for(const T &v : trace_sorted) {
+			m2 += (static_cast<double>(v) - mean) * (static_cast<double>(v) - mean);
+		}
+		const T floor_value = static_cast<T>(mean - std::sqrt(m2 / file_size));
+
+		const T threshold = trace_sorted[nelems];
+		const T scale = ws.gpd.get_sigma() + std::max(trace_sorted[nelems - 1] - floor_value, T(0));
+		const T half_width = static_cast<T>(bsc_limits<Policy>.get(nelems));
+		ws.high_gpd.set_parameters(threshold, scale / (1 - half_width), 0, threshold);
+		ws.gpd.set_parameters(ws.high_gpd.get_parameters());
+	}
+	ws.gpd.set_trace_usage(window, file_size, complete);
+	clock.stop();
+
+	ws.stats.analyses = 1;
+	ws.stats.samples = file_size;
+	ws.stats.nelems = nelems;
+	ws.stats.counted = clock.has_counters() ? 1 : 0;
+	ws.stats.bytes_allocated = ws.capacity_bytes() - capacity;
+	thread_stats() += ws.stats;
+}
+
+template <typename T, typename Policy>
+void BSCTimingAnalyzer<T, Policy>::perform_decimated_analysis(const Request<T> &req, BSCWorkspace<T> &ws,
+                                                      size_t tail_samples, DecimationReport &report,
+                                                      const AnalysisControl &control) const {
+	control.check();
+
+	const auto &values = req.get_all();
+
+	if(values.size() <= 10) {
+		throw TimingAnalyzerError("The number of samples is '10' or less in the Request. "
+							      "Please get more samples.", error_t::INVALID_DATA);
+	}
+
+	ws.stats.reset();
+	PhaseClock clock(ws.stats);
+	const size_t capacity = ws.capacity_bytes();
+
+	clock.enter(phase_t::COPY);
+	auto &trace = ws.trace;
+	trace.assign(values.cbegin(), values.cend());
+
+	const int file_size = trace.size();
+	const int half_size = floor(file_size/2);
+
+	report = DecimationReport();
+	report.input_samples = file_size;
+
+	int window = static_cast<int>(std::min<size_t>(std::max<size_t>(tail_samples, minvalues + 2),
+	                                               half_size));
+	int sorted = 0;
+	int nelems;
+
+	while(true) {
+		// Only the samples not selected by the previous rounds are partitioned again
+		clock.enter(phase_t::SORT);
+		std::nth_element(trace.begin() + sorted, trace.begin() + window, trace.end(),
+		                 std::greater<T>());
+		std::sort(trace.begin() + sorted, trace.begin() + window, std::greater<T>());
+		sorted = window;
+		control.check();
+
+		clock.enter(phase_t::CV_SCAN);
+		nelems = select_tail_size(trace, window, control);
+		report.rounds++;
+
+		// If the scan stopped inside the window it stopped where the full scan would
+		if(window == half_size || nelems < window - 2) {
+			break;
+		}
+		report.saturated = true;
+		window = std::min(2 * window, half_size);
+	}
+	control.check();
+
+	clock.enter(phase_t::GRID);
+	fit_tail(trace, nelems, ws, control);
+	ws.gpd.set_trace_usage(file_size, file_size, true);
+	clock.stop();
+
+	report.tail_samples  = window;
+	report.body_samples  = file_size - window;
+	report.pre_threshold = static_cast<double>(trace[window - 1]);
+	report.nelems        = nelems;
+
+	ws.stats.analyses = 1;
+	ws.stats.samples = file_size;
+	ws.stats.nelems = nelems;
+	ws.stats.counted = clock.has_counters() ? 1 : 0;
+	ws.stats.bytes_allocated = ws.capacity_bytes() - capacity;
+	thread_stats() += ws.stats;
+}
+
+template <typename T, typename Policy>
+void BSCTimingAnalyzer<T, Policy>::perform_partitioned_analysis(const Request<T> &req,
+                                                               PartitionedResult<T> &result,
+                                                               bool envelope, unsigned workers,
+                                                               const AnalysisControl &control) const {
+	control.check();
+
+	const RequestPartitions<T> parts(req);
+	const size_t count = parts.size();
+
+	result.partitions.clear();
+	if(count == 0) {
+		// Nothing to analyze: the envelope, if requested, is empty
+		result.envelope = envelope ? std::make_shared<ResponseEVTEnvelope>() : nullptr;
+		return;
+	}
+	for(size_t i = 0; i < count; i++) {
+		result.partitions.push_back({parts.get_tag(i), parts.get_count(i),
+		                             AnalysisResult<T>::error(error_t::INVALID_DATA)});
 	}
 
-	//Compute the region of acceptance for the exponential tail.
-	//This is the red cone in a CV-plot
-	//Impose the template enforce the type casting of the input
-	//assert(limitbelow.size() == limitabove.size());
-	for(size_t i=0; i<limitabove.size(); i++) {
-		T tmp = (1.96/internalSqrt<T>(half_size-i));
-		limitabove[i]=1 + tmp;
-		//limitbelow[i]=1 - tmp;
+	if(workers == 0) {
+		workers = std::thread::hardware_concurrency();
 	}
+	workers = static_cast<unsigned>(std::max<size_t>(1, std::min<size_t>(workers, count)));
 
-	assert(limitabove.size() == cv.size());
+	// Every worker takes the next partition to analyze, so the long ones do not unbalance them
+	std::atomic<size_t> next(0);
+	std::exception_ptr failure;
+	std::mutex failure_mutex;
+	const auto work = [&]() {
+		BSCWorkspace<T> ws;
+		size_t i;
+		while((i = next.fetch_add(1)) < count) {
+			try {
+				this->perform_analysis(parts.get_values(i), parts.get_count(i), ws, control);
+				result.partitions[i].result = AnalysisResult<T>::distribution(ws.get_result());
+			} catch(const TimingAnalyzerError &e) {
+				result.partitions[i].result = AnalysisResult<T>::error(e.get_type());
+			} catch(...) {
+				std::lock_guard<std::mutex> lock(failure_mutex);
+				failure = std::current_exception();
+				next.store(count);
+			}
+		}
+	};
+
+	{
+		std::vector<std::thread> threads;
+		threads.reserve(workers - 1);
+		ThreadJoiner joiner(threads);
+		for(unsigned w = 1; w < workers; w++) {
+			try {
+				threads.emplace_back(work);
+			} catch(const std::system_error &) {
+				// The calling thread and the started workers take the remaining partitions
+				break;
+			}
+		}
+		work();
+	}
+
+	if(failure) {
+		std::rethrow_exception(failure);
+	}
+	control.check();
+
+	result.envelope = nullptr;
+	if(envelope) {
+		result.envelope = std::make_shared<ResponseEVTEnvelope>();
+		for(const auto &p : result.partitions) {
+			if(p.result.is_distribution()) {
+				result.envelope->add(p.result.get_dist_type(), p.result.get_parameters());
+			}
+		}
+	}
+}
+
+template <typename T, typename Policy>
+AnalysisResult<T> BSCTimingAnalyzer<T, Policy>::analyze(const Request<T> &req) {
+	static thread_local BSCWorkspace<T> ws;
+	return this->analyze(req, ws);
+}
+
+template <typename T, typename Policy>
+AnalysisResult<T> BSCTimingAnalyzer<T, Policy>::analyze(const Request<T> &req, BSCWorkspace<T> &ws) const {
+	try {
+		this->perform_analysis(req, ws);
+	} catch(const TimingAnalyzerError &e) {
+		return AnalysisResult<T>::error(e.get_type());
+	}
+	return AnalysisResult<T>::distribution(ws.get_result());
+}
+
+template <typename T, typename Policy>
+std::shared_ptr<ResponseEVTDistribution> BSCTimingAnalyzer<T, Policy>::perform_anytime_analysis(
+                                                            std::shared_ptr<Request<T>> req,
+                                                            AnalysisControl::clock_t::duration budget) {
+
+	const auto start = AnalysisControl::clock_t::now();
+	const auto deadline = start + budget;
+
+	auto trace = req->get_all();
+
+	if(trace.size() <= 10) {
+		throw TimingAnalyzerError("The number of samples is '10' or less in the Request. "
+							      "Please get more samples.", error_t::INVALID_DATA);
+	}
+
+	const int file_size = trace.size();
+	const int half_size = floor(file_size/2);
+
+	// The CV scan only looks at the top of the trace, so the estimate is refined by doubling the
+	// number of top samples considered. The top-k are selected incrementally: at every round
+	// only the samples not yet selected are partitioned.
+	BSCWorkspace<T> ws;
+	std::shared_ptr<ResponseEVTDistribution> result;
+	int window = std::min(anytime_initial_window, half_size);
+	int sorted = 0;
+	// Lower bound of the threshold of any tail the full scan can select, computed on demand
+	bool has_floor = false;
+	T floor_value = T(0);
+
+	while(true) {
+		const auto round_start = AnalysisControl::clock_t::now();
+
+		if(window < file_size) {
+			std::nth_element(trace.begin() + sorted, trace.begin() + window, trace.end(),
+			                 std::greater<T>());
+		}
+		std::sort(trace.begin() + sorted, trace.begin() + window, std::greater<T>());
+		sorted = window;
+
+		// The result is the one of the full analysis, unless the whole window is inside the
+		// cone: in that case the tail may continue below the window.
+		const int nelems = select_tail_size(trace, window, AnalysisControl());
+		const bool complete = window == half_size || nelems < window - 2;
+
+		if(nelems >= minvalues) {
+			fit_tail(trace, nelems, ws, AnalysisControl());
+			if(! complete) {
+				// The full scan selects a tail of n >= nelems samples, whose threshold is not
+				// above the current one and whose excess mean is not above the one of the
+				// current tail plus the distance of its last sample from the median (the lowest
+				// possible threshold). With the confidence interval of nelems samples, wider than
+				// the one of n, the estimate dominates the full one and its upper bound.
+				if(! has_floor) {
+					if(half_size - 3 >= sorted) {
+						std::nth_element(trace.begin() + sorted, trace.begin() + (half_size - 3),
+						                 trace.end(), std::greater<T>());
+					}
+					floor_value = trace[half_size - 3];
+					has_floor = true;
+				}
+				const T threshold = trace[nelems];
+				const T scale = ws.gpd.get_sigma() + (trace[nelems - 1] - floor_value);
+				const T half_width = static_cast<T>(bsc_limits<Policy>.get(nelems));
+				ws.high_gpd.set_parameters(threshold, scale / (1 - half_width), 0, threshold);
+			}
+			set_bounds(ws);
+			result = std::make_shared<ResponseEVTDistribution>(complete ? ws.get_result()
+			                                                            : ws.get_high_gpd());
+			result->set_trace_usage(window, file_size, complete);
+		}
+
+		if(complete) {
+			break;
+		}
+
+		// The CV scan is quadratic in the window size: stop if the next round is not
+		// expected to fit in the remaining budget
+		const auto now = AnalysisControl::clock_t::now();
+		const int next_window = std::min(2 * window, half_size);
+		const auto round_time = now - round_start;
+		if(result && now + 4 * round_time > deadline) {
+			break;
+		}
+		window = next_window;
+	}
+
+	if(! result) {
+		// Not even the complete trace provides a tail: fail as perform_analysis() does
+		throw_minvalues_error(window - 2, file_size);
+	}
+
+	return result;
+}
+
+template <typename T, typename Policy>
+int BSCTimingAnalyzer<T, Policy>::select_tail_size(const std::vector<T> &trace_sorted, int half_size,
+                                           const AnalysisControl &control) const {
+
+	if(this->threshold == threshold_t::MRL) {
+		return select_tail_size_mrl(trace_sorted, half_size, control);
+	}
 
 	int nelems =  0;
-	
-	//Find the values below the limitabove starting from the end
-	for(int i=cv.size()-1; i>=0; i--) {
-		        //Impose the template enforce the type casting of the input
-		T upperLimit = 1 + (1.96/internalSqrt<T>(half_size-i-2));
-		if(cv[i]>=upperLimit)
+
+	//Compute the CV = Coefficient of Variation. It is the std_dev/mean
+	//The CV of the top usedSamples values must stay inside the region of acceptance for the
+	//exponential tail (the red cone in a CV-plot). Starting from the smallest tail, the first
+	//value outside the cone stops the scan, so the remaining CVs are not computed at all.
+	for(int usedSamples = 1; usedSamples <= half_size - 2; usedSamples++) {
+		T mean = getUnbiasedMean(trace_sorted,0,usedSamples,summation);
+		T std_deviation = getUnbiasedStdDeviation(trace_sorted,0,usedSamples,summation);
+		T cv = std_deviation/mean;
+
+		//The half-widths of the cone come from the table computed at compile time for the policy
+		T upperLimit = 1 + static_cast<T>(bsc_limits<Policy>.get(usedSamples));
+		if(cv>=upperLimit)
 			break;
 		nelems++;
+
+		// The CV scan is quadratic, so do not wait for its end to abandon the analysis
+		if((usedSamples & 0xFF) == 0) {
+			control.check();
+		}
+	}
+
+	return nelems;
+}
+
+template <typename T, typename Policy>
+int BSCTimingAnalyzer<T, Policy>::select_tail_size_mixed(const std::vector<double> &trace_sorted,
+                                                         int half_size,
+                                                         const AnalysisControl &control) const {
+
+	if(this->threshold == threshold_t::MRL) {
+		return select_tail_size_mrl(trace_sorted, half_size, control);
 	}
+
+	int nelems = 0;
+
+	//The same scan of select_tail_size(), but the sums of the distances d from the maximum are
+	//updated incrementally instead of recomputed for every tail size. The distances are small
+	//with respect to the samples and their sums are compensated, so no precision is lost.
+	NeumaierSum<double> sum, squares;
+	for(int usedSamples = 1; usedSamples <= half_size - 2; usedSamples++) {
+		const double d = trace_sorted[0] - trace_sorted[usedSamples - 1];
+		sum.add(d);
+		squares.add(d * d);
+
+		const double k = usedSamples;
+		const double mean = d - sum.get() / k;
+		const double variance = (squares.get() - sum.get() * sum.get() / k) / (k - 1);
+		const double cv = std::sqrt(std::max(variance, 0.)) / mean;
+
+		const double upperLimit = 1 + static_cast<double>(bsc_limits<Policy>.get(usedSamples));
+		if(cv>=upperLimit)
+			break;
+		nelems++;
+
+		if((usedSamples & 0xFFFF) == 0) {
+			control.check();
+		}
+	}
+
+	return nelems;
+}
+
+template <typename T, typename Policy>
+template <typename U>
+int BSCTimingAnalyzer<T, Policy>::select_tail_size_mrl(const std::vector<U> &trace_sorted,
+                                                       int half_size,
+                                                       const AnalysisControl &control) const {
+
+	int nelems = 0;
+
+	//The mean excess over the threshold x[k-1] of the top k samples is e(k) = S(k)/k - x[k-1],
+	//with S(k) the prefix sum of the sorted trace. On an exponential tail it is constant, inside
+	//the band e(j)*(1 -+ z/sqrt(j)) of any larger threshold, at the confidence of the policy.
+	//Lowering the threshold, the selection stops when e(k):
+	// - rises above the upper bounds of all the larger thresholds (their minimum is kept): the
+	//   body of the distribution has been reached;
+	// - falls below the lower bound of the tail twice as small, e(k/2): the tail is heavier than
+	//   exponential. Comparing only with k/2 tolerates a few outliers on top, whose weight in
+	//   e(k) vanishes quickly.
+	//Two prefix sums, of the top k and k/2 samples, are updated incrementally, so the selection
+	//is a single pass. They are sums of the distances d from the maximum, which are small and
+	//compensated.
+	NeumaierSum<double> sum, half_sum;
+	double bound = std::numeric_limits<double>::infinity();
+	int half = 0;
+	for(int k = 1; k <= half_size - 2; k++) {
+		const double d = static_cast<double>(trace_sorted[0] - trace_sorted[k - 1]);
+		sum.add(d);
+		if(k / 2 > half) {
+			half++;
+			half_sum.add(static_cast<double>(trace_sorted[0] - trace_sorted[half - 1]));
+		}
+
+		const double excess = d - sum.get() / k;
+		if(k < minvalues || (nelems == 0 && excess <= 0)) {
+			continue;
+		}
+		if(excess > bound)
+			break;
+		if(half >= minvalues) {
+			const double half_excess = static_cast<double>(trace_sorted[0] - trace_sorted[half - 1])
+			                           - half_sum.get() / half;
+			if(excess < half_excess / (1 + static_cast<double>(bsc_limits<Policy>.get(half))))
+				break;
+		}
+
+		const double half_width = static_cast<double>(bsc_limits<Policy>.get(k));
+		if(half_width < 1) {
+			bound = std::min(bound, excess / (1 - half_width));
+		}
+		nelems = k;
+
+		if((k & 0xFFFF) == 0) {
+			control.check();
+		}
+	}
+
+	return nelems;
+}
+
+template <typename T, typename Policy>
+void BSCTimingAnalyzer<T, Policy>::fit_tail(const std::vector<T> &trace_sorted, int nelems,
+                                    BSCWorkspace<T> &ws, const AnalysisControl &control) const {
+
 	T threshold=trace_sorted[nelems];
     //We need at least minvalues samples to estimate the tail.
     //If this property is not satisfied, we're force to fail.
     if(nelems < minvalues) {
-		throw TimingAnalyzerError(std::string("Minvalues samples are not satisfied nelems: ")+std::to_string(nelems)+
-								 std::string(" minvalues: ")+std::to_string(minvalues)+
-								 std::string(" samples: ")+std::to_string(trace_sorted.size()), error_t::INVALID_DATA);
+		throw_minvalues_error(nelems, trace_sorted.size());
 	}
 
-    T excessesMean = getUnbiasedMean(trace_sorted,0,nelems);
+    T excessesMean = getUnbiasedMean(trace_sorted,0,nelems,summation);
 	if(excessesMean == T(0)) {
 		throw TimingAnalyzerError("No sufficient variability in the samples.", error_t::INVALID_DATA);
 	}
-    std::vector<T> tailValues(trace_sorted.begin(), trace_sorted.begin()+nelems);
-	//const T tailValuesMean= std::accumulate(tailValues.begin(),tailValues.end(),T(0))/tailValues.size();
     const T rate = 1/excessesMean;
-    //Impose the template enforce the type casting of the input
-    const T ratelow = rate * (1 + (1.96/internalSqrt<T>(nelems)));
-    const T ratehigh = rate *(1 - (1.96/internalSqrt<T>(nelems)));
+    //Confidence interval of the rate at the confidence level of the policy
+    const T half_width = static_cast<T>(bsc_limits<Policy>.get(nelems));
+    const T ratelow = rate * (1 + half_width);
+    const T ratehigh = rate *(1 - half_width);
 
     //Biggest value in nelems is the MET
    // const T rank_end =20 * trace_sorted[0] ;
@@ -86,40 +714,88 @@ std::shared_ptr<Response> BSCTimingAnalyzer<T>::perform_analysis(std::shared_ptr
     const T rank_start = 0 ;
     const T rank_step = (rank_end - rank_start)/ (rank_length-1);
     //Generate values for rank
-    std::vector<T> rank(rank_length,0);
-    std::vector<T> probCCDF(rank_length,0);
-    std::vector<T> probCCDFlow(rank_length,0);
-    std::vector<T> probCCDFhigh(rank_length,0);
-    arange(rank,rank_start,rank_step);
+    ws.rank.assign(rank_length,0);
+    ws.probCCDF.assign(rank_length,0);
+    ws.probCCDFlow.assign(rank_length,0);
+    ws.probCCDFhigh.assign(rank_length,0);
+    arange(ws.rank,rank_start,rank_step);
 
     //The most expensive step is this one. Especially if you use long double
-    setExponSurvivalFunction(probCCDF,rank, rate);
-    setExponSurvivalFunction(probCCDFlow,rank, ratelow);
-    setExponSurvivalFunction(probCCDFhigh,rank, ratehigh);
+    setExponSurvivalFunction(ws.probCCDF,ws.rank, rate);
+    setExponSurvivalFunction(ws.probCCDFlow,ws.rank, ratelow);
+    setExponSurvivalFunction(ws.probCCDFhigh,ws.rank, ratehigh);
     //Add mean to all the rank values.
     //TODO!!! already create rank starting from the mean and keep it into
     // account while generating the survival function.
-    for( auto &v : rank )  v += trace_sorted[nelems-1];
+    for( auto &v : ws.rank )  v += trace_sorted[nelems-1];
 
     //TODO estimate the real type of tail
 
 
 	// TODO add mean value
 
-	this->low_gpd = std::make_shared <ResponseEVTDistribution> (distribution_type_e::EVT_GPD_2PARAM);
-	this->low_gpd->set_parameters(threshold, 1/ratelow, 0,threshold);
-	this->high_gpd = std::make_shared <ResponseEVTDistribution> (distribution_type_e::EVT_GPD_2PARAM);
-	this->high_gpd->set_parameters(threshold, 1/ratehigh, 0,threshold);
+	control.check();
 
-	auto gpd = std::make_shared <ResponseEVTDistribution> (distribution_type_e::EVT_GPD_2PARAM);
-	gpd->set_parameters(threshold, 1/rate, 0, threshold);
+	ws.low_gpd.set_parameters(threshold, 1/ratelow, 0,threshold);
+	ws.high_gpd.set_parameters(threshold, 1/ratehigh, 0,threshold);
+	ws.gpd.set_parameters(threshold, 1/rate, 0, threshold);
+}
 
-    return gpd;
+template <typename T, typename Policy>
+void BSCTimingAnalyzer<T, Policy>::throw_minvalues_error(int nelems, size_t samples) const {
+	throw TimingAnalyzerError(std::string("Minvalues samples are not satisfied nelems: ")+std::to_string(nelems)+
+							 std::string(" minvalues: ")+std::to_string(minvalues)+
+							 std::string(" samples: ")+std::to_string(samples), error_t::INVALID_DATA);
+}
+
+template <typename T, typename Policy>
+std::shared_ptr<Response> BSCTimingAnalyzer<T, Policy>::restore_from_cache(const EVTRecord &record,
+                                                                   size_t samples) {
 
+	auto low_gpd = std::make_shared <ResponseEVTDistribution> (record.dist_type);
+	low_gpd->set_parameters(record.low);
+	auto high_gpd = std::make_shared <ResponseEVTDistribution> (record.dist_type);
+	high_gpd->set_parameters(record.high);
+	set_bounds(low_gpd, high_gpd);
+
+	auto gpd = std::make_shared <ResponseEVTDistribution> (record.dist_type);
+	gpd->set_parameters(record.params);
+	gpd->set_trace_usage(samples, samples, true);
+
+	return gpd;
+}
+
+template <typename T, typename Policy>
+void BSCTimingAnalyzer<T, Policy>::store_to_cache(uint64_t key, const ResponseEVTDistribution &gpd,
+                                          const ResponseEVTDistribution &low,
+                                          const ResponseEVTDistribution &high) const {
+
+	EVTRecord record;
+	record.dist_type  = gpd.get_dist_type();
+	record.params     = gpd.get_parameters();
+	record.has_bounds = true;
+	record.low        = low.get_parameters();
+	record.high       = high.get_parameters();
+
+	// A failure in writing the cache is not fatal: the result is simply recomputed next time
+	(void) this->cache->store(key, record);
 }
 
-template <typename T>
-T BSCTimingAnalyzer<T>::get_wcet_at_p(double p, double mu, double sg, double xi) const {
+template <typename T, typename Policy>
+void BSCTimingAnalyzer<T, Policy>::set_bounds(const BSCWorkspace<T> &ws) {
+	set_bounds(std::make_shared <ResponseEVTDistribution> (ws.get_low_gpd()),
+	           std::make_shared <ResponseEVTDistribution> (ws.get_high_gpd()));
+}
+
+template <typename T, typename Policy>
+void BSCTimingAnalyzer<T, Policy>::set_bounds(std::shared_ptr<ResponseEVTDistribution> low,
+                                      std::shared_ptr<ResponseEVTDistribution> high) {
+	std::shared_ptr<const Bounds> bounds = std::make_shared<Bounds>(Bounds{std::move(low), std::move(high)});
+	std::atomic_store(&this->bounds, std::move(bounds));
+}
+
+template <typename T, typename Policy>
+T BSCTimingAnalyzer<T, Policy>::get_wcet_at_p(double p, double mu, double sg, double xi) const {
     if (p <= 0. || p >= 1.) {
         throw std::invalid_argument("The probability value is not valid.");
     }
@@ -135,14 +811,16 @@ T BSCTimingAnalyzer<T>::get_wcet_at_p(double p, double mu, double sg, double xi)
     return quantile;
 }
 
-template <typename T>
-T BSCTimingAnalyzer<T>::get_high_wcet_at_p(double x) const {
-	return BSCTimingAnalyzer<T>::get_wcet_at_p(x, this->high_gpd->get_mu(), this->high_gpd->get_sigma(), this->high_gpd->get_xi()); 
+template <typename T, typename Policy>
+T BSCTimingAnalyzer<T, Policy>::get_high_wcet_at_p(double x) const {
+	const auto high_gpd = std::atomic_load(&this->bounds)->high;
+	return BSCTimingAnalyzer<T, Policy>::get_wcet_at_p(x, high_gpd->get_mu(), high_gpd->get_sigma(), high_gpd->get_xi());
 }
 
-template <typename T>
-T BSCTimingAnalyzer<T>::get_low_wcet_at_p(double x) const {
-	return BSCTimingAnalyzer<T>::get_wcet_at_p(x, this->low_gpd->get_mu(), this->low_gpd->get_sigma(), this->low_gpd->get_xi()); 
+template <typename T, typename Policy>
+T BSCTimingAnalyzer<T, Policy>::get_low_wcet_at_p(double x) const {
+	const auto low_gpd = std::atomic_load(&this->bounds)->low;
+	return BSCTimingAnalyzer<T, Policy>::get_wcet_at_p(x, low_gpd->get_mu(), low_gpd->get_sigma(), low_gpd->get_xi());
 }
 
 template class BSCTimingAnalyzer<unsigned int>;
@@ -153,4 +831,11 @@ template class BSCTimingAnalyzer<float>;
 template class BSCTimingAnalyzer<double>;
 template class BSCTimingAnalyzer<long double>;
 
+template class BSCTimingAnalyzer<float, BSCPolicy90>;
+template class BSCTimingAnalyzer<double, BSCPolicy90>;
+template class BSCTimingAnalyzer<long double, BSCPolicy90>;
+template class BSCTimingAnalyzer<float, BSCPolicy99>;
+template class BSCTimingAnalyzer<double, BSCPolicy99>;
+template class BSCTimingAnalyzer<long double, BSCPolicy99>;
+
 } //namespace libta
@@ -9,39 +9,341 @@
 #define BSCTA_H_
 
 #include "libta.h"
+#include "libta_cache.h"
+#include "libta_decimation.h"
+#include "libta_partition.h"
+#include "libta_stats.h"
+#include "libta_summary.h"
+
+#include "bscta_policy.h"
+#include "libta_math.h"
 
 namespace libta {
 
+template <typename T, typename Policy = BSCPolicy<>>
+class BSCTimingAnalyzer;
+
+/**
+ * @brief The arithmetic used by the BSCTimingAnalyzer
+ */
+typedef enum class precision_e {
+	NATIVE,     /**< The whole analysis is performed in T */
+	MIXED       /**< Sort and CV scan in double with compensated sums, tail fit in T */
+} precision_t;
+
+/**
+ * @brief The rule selecting the tail samples (the threshold) in the BSCTimingAnalyzer
+ */
+typedef enum class threshold_e {
+	CV_CONE,    /**< The CV of the tail must stay inside the acceptance cone of exponential tails */
+	MRL         /**< The mean residual life (mean excess over the threshold) must stay inside the
+	                 confidence bands of the larger thresholds */
+} threshold_t;
+
+/**
+ * @brief Reusable memory of the BSCTimingAnalyzer.
+ *
+ * The buffers are sized on first use and then reused, so that repeated analyses of traces of
+ * similar length perform no heap allocation. The results of the last analysis are stored in
+ * the workspace itself. A workspace must not be shared among concurrent analyses, but any
+ * number of workspaces can be used concurrently with the same analyzer.
+ */
 template <typename T>
+class BSCWorkspace {
+
+public:
+
+	BSCWorkspace() noexcept : gpd(distribution_type_e::EVT_GPD_2PARAM),
+	                          low_gpd(distribution_type_e::EVT_GPD_2PARAM),
+	                          high_gpd(distribution_type_e::EVT_GPD_2PARAM) {
+	}
+
+	/** @brief Pre-allocate the buffers, so that even the first analysis does not allocate */
+	void reserve(size_t samples, int rank_length) {
+		this->trace.reserve(samples);
+		this->rank.reserve(rank_length);
+		this->probCCDF.reserve(rank_length);
+		this->probCCDFlow.reserve(rank_length);
+		this->probCCDFhigh.reserve(rank_length);
+	}
+
+	/** @brief The distribution estimated by the last analysis */
+	inline const ResponseEVTDistribution &get_result() const noexcept {
+		return this->gpd;
+	}
+
+	/** @brief The lower bound of the distribution estimated by the last analysis */
+	inline const ResponseEVTDistribution &get_low_gpd() const noexcept {
+		return this->low_gpd;
+	}
+
+	/** @brief The upper bound of the distribution estimated by the last analysis */
+	inline const ResponseEVTDistribution &get_high_gpd() const noexcept {
+		return this->high_gpd;
+	}
+
+	/** @brief The statistics of the last analysis */
+	inline const AnalysisStats &get_stats() const noexcept {
+		return this->stats;
+	}
+
+private:
+	template <typename U, typename Policy>
+	friend class BSCTimingAnalyzer;
+
+	std::vector<T> trace;
+	std::vector<double> bulk;   // The trace in the MIXED precision analysis
+	std::vector<T> rank;
+	std::vector<T> probCCDF;
+	std::vector<T> probCCDFlow;
+	std::vector<T> probCCDFhigh;
+
+	ResponseEVTDistribution gpd;
+	ResponseEVTDistribution low_gpd;
+	ResponseEVTDistribution high_gpd;
+
+	AnalysisStats stats;
+
+	size_t capacity_bytes() const noexcept {
+		return (trace.capacity() + rank.capacity() + probCCDF.capacity() + probCCDFlow.capacity()
+		        + probCCDFhigh.capacity()) * sizeof(T) + bulk.capacity() * sizeof(double);
+	}
+};
+
+/**
+ * @brief The BSC timing analyzer
+ * @tparam Policy  The confidence level and the minimum tail size, see BSCPolicy
+ */
+template <typename T, typename Policy>
 class BSCTimingAnalyzer : public TimingAnalyzer<T> {
 
 public:
 
-	BSCTimingAnalyzer(int rank_length = 90000) noexcept : rank_length(rank_length) {
+	/**
+	 * @brief The BSCTimingAnalyzer class constructor
+	 * @param rank_length  The resolution of the survival functions
+	 * @param precision    With MIXED, the sort and the CV scan, which touch the whole trace, are
+	 *                     performed in double and only the tail fit in T. A long double analyzer
+	 *                     then runs at nearly the speed of a double one, with nearly the accuracy
+	 *                     of long double. The samples are rounded to double, which is exact for
+	 *                     integer times up to 2^53.
+	 * @param summation    The algorithm of the sums over the tail samples. The compensated and
+	 *                     pairwise ones make float traces, which halve the memory traffic, safe
+	 *                     to analyze. The MIXED scan always uses compensated sums.
+	 * @param threshold    The rule selecting the tail. MRL needs a single linear pass over the
+	 *                     top half of the trace, and it always keeps at least the minimum number
+	 *                     of tail samples, also on traces whose CV cone is left too early.
+	 */
+	BSCTimingAnalyzer(int rank_length = 90000, precision_t precision = precision_t::NATIVE,
+	                  summation_t summation = summation_t::NAIVE,
+	                  threshold_t threshold = threshold_t::CV_CONE) noexcept
+		: rank_length(rank_length), precision(precision), summation(summation),
+		  threshold(threshold) {
 	}
 
 	virtual ~BSCTimingAnalyzer() = default;
 
 	virtual std::shared_ptr<Response> perform_analysis(std::shared_ptr<Request<T>> req) override;
 
+	/**
+	 * @brief Perform the analysis checking the cancellation token and the deadline after the
+	 *        sort, during the CV scan and before the fit of the tail.
+	 */
+	virtual std::shared_ptr<Response> perform_analysis(std::shared_ptr<Request<T>> req,
+	                                                   const AnalysisControl &control) override;
+
+	/**
+	 * @brief Perform the analysis using the caller-supplied workspace, where the results are
+	 *        stored. No heap allocation is performed once the workspace buffers are large enough.
+	 *
+	 * This method does not modify the analyzer: neither the cache nor get_low_gpd() and
+	 * get_high_gpd() are involved. The statistics of the analysis are stored in the workspace
+	 * and accumulated in thread_stats().
+	 */
+	void perform_analysis(const Request<T> &req, BSCWorkspace<T> &ws,
+	                      const AnalysisControl &control = AnalysisControl()) const;
+
+	/**
+	 * @brief Perform the analysis of a caller-owned array of samples, using the caller-supplied
+	 *        workspace. The samples are copied only once, into the workspace, and converted to T
+	 *        while copied, so U can differ from T.
+	 */
+	template <typename U>
+	void perform_analysis(const U *values, size_t size, BSCWorkspace<T> &ws,
+	                      const AnalysisControl &control = AnalysisControl()) const {
+		analyze_trace(values, size, &copy_values<U>, ws, control);
+	}
+
+	/**
+	 * @brief Perform the analysis of a (possibly merged) tail summary, using the caller-supplied
+	 *        workspace.
+	 *
+	 * The result is equal to the one of the analysis of the whole trace if the threshold
+	 * selection stops inside the top samples of the summary. Otherwise the tail may continue
+	 * below them: the result dominates the one of the whole trace, as the incomplete estimates of
+	 * perform_anytime_analysis(), using the body moments to bound the median of the trace. It is
+	 * reported as not complete (see ResponseEVTDistribution::is_complete()).
+	 */
+	void perform_analysis(const TailSummary<T> &summary, BSCWorkspace<T> &ws,
+	                      const AnalysisControl &control = AnalysisControl()) const;
+
+	/**
+	 * @brief Perform the analysis looking only at the top samples of the trace.
+	 *
+	 * The top tail_samples samples are selected in linear time and only them are sorted and
+	 * scanned, the rest of the trace (the body) is never sorted. If the threshold selection
+	 * reaches the bottom of the selected tail, the tail may continue below it: the number of
+	 * selected samples is doubled and the scan repeated. The result is therefore always equal
+	 * to the one of perform_analysis(), but the cost depends on the tail size instead of the
+	 * trace size. The report describes the selection performed.
+	 */
+	void perform_decimated_analysis(const Request<T> &req, BSCWorkspace<T> &ws, size_t tail_samples,
+	                                DecimationReport &report,
+	                                const AnalysisControl &control = AnalysisControl()) const;
+
+	/**
+	 * @brief Perform one analysis per tag of the request (see RequestPartitions).
+	 *
+	 * The partitions are analyzed in parallel by up to workers threads (0 for one per hardware
+	 * thread), each one with its own workspace. If a thread cannot be started, the calling
+	 * thread and the threads already started analyze the remaining partitions. A partition that
+	 * cannot be analyzed, e.g. with too few samples, is reported as an error result; cancellation
+	 * and deadline expiration are thrown as usual. An empty request has no partitions.
+	 *
+	 * @param envelope  If true, result.envelope is set to the envelope of all the distributions,
+	 *                  otherwise to nullptr
+	 */
+	void perform_partitioned_analysis(const Request<T> &req, PartitionedResult<T> &result,
+	                                  bool envelope = false, unsigned workers = 0,
+	                                  const AnalysisControl &control = AnalysisControl()) const;
+
+	/**
+	 * @brief Perform the analysis and return the result by value.
+	 *
+	 * A thread-local workspace is used, so that in steady state no heap allocation is
+	 * performed. The analyzer bounds (get_low_gpd() and get_high_gpd()) are not updated.
+	 */
+	virtual AnalysisResult<T> analyze(const Request<T> &req) override;
+
+	/** @brief Perform the analysis and return the result by value, using the given workspace */
+	AnalysisResult<T> analyze(const Request<T> &req, BSCWorkspace<T> &ws) const;
+
+	/**
+	 * @brief Anytime analysis: produce an estimate within the given time budget.
+	 *
+	 * A first estimate is computed from the top samples of the trace only, then it is refined by
+	 * doubling the number of top samples considered as long as the next round is expected to fit
+	 * in the budget. The response reports how many samples have been used and whether the
+	 * estimate is complete, i.e. equal to the one of perform_analysis(). Incomplete estimates
+	 * dominate both the result of perform_analysis() and the upper bound of its confidence
+	 * interval: the tail that the full analysis would select is unknown, so the estimate uses
+	 * the largest excess mean that any longer tail could have. They are safe, but can be much
+	 * more pessimistic than the complete estimate.
+	 *
+	 * @note The first estimate is always produced, even if it exceeds the budget.
+	 */
+	std::shared_ptr<ResponseEVTDistribution> perform_anytime_analysis(std::shared_ptr<Request<T>> req,
+	                                                      AnalysisControl::clock_t::duration budget);
+
+	// The bounds are published together with a single atomic swap, so that an abandoned
+	// asynchronous analysis running concurrently with a newer one never leaves the low bound of
+	// one analysis with the high bound of the other. Separate calls to get_low_gpd() and
+	// get_high_gpd() can still observe different analyses: use get_bounds() to read both.
 	virtual std::shared_ptr<Response> get_high_gpd() const noexcept {
-		return this->high_gpd;
+		const auto bounds = std::atomic_load(&this->bounds);
+		return bounds ? bounds->high : nullptr;
 	}
 
 	virtual std::shared_ptr<Response> get_low_gpd() const noexcept {
-		return this->low_gpd;
+		const auto bounds = std::atomic_load(&this->bounds);
+		return bounds ? bounds->low : nullptr;
+	}
+
+	/** @brief Getter for the low and high bounds of the same analysis, nullptr if none yet */
+	void get_bounds(std::shared_ptr<Response> &low, std::shared_ptr<Response> &high) const noexcept {
+		const auto bounds = std::atomic_load(&this->bounds);
+		low = bounds ? bounds->low : nullptr;
+		high = bounds ? bounds->high : nullptr;
 	}
 
 	virtual T get_high_wcet_at_p(double x) const;
 	virtual T get_low_wcet_at_p(double x) const;
+
+	/**
+	 * @brief Attach a persistent cache of results. When set, perform_analysis() restores the
+	 *        result (and the low/high bounds) of an already analyzed trace instead of running
+	 *        the analysis again. Pass nullptr to disable the cache.
+	 */
+	void set_result_cache(std::shared_ptr<ResultCache> cache) noexcept {
+		this->cache = std::move(cache);
+	}
+
+	/** @brief Hash of the configuration parameters affecting the analysis result */
+	uint64_t get_configuration_hash() const noexcept {
+		return hash_mix(hash_mix(hash_mix(hash_mix(hash_mix(0x6273637461ULL, sizeof(T)), this->rank_length),
+		                                  Policy::min_tail),
+		                         static_cast<uint64_t>(Policy::confidence * 1000 + 0.5)),
+		                static_cast<uint64_t>(this->threshold) << 16
+		                | static_cast<uint64_t>(this->precision) << 8
+		                | static_cast<uint64_t>(this->summation));
+	}
+
 private:
+	static constexpr int minvalues = Policy::min_tail;  /**< Minimum number of tail samples */
+	static constexpr int anytime_initial_window = 64;  /**< Top samples of the first anytime round */
+
 	const int rank_length;
+	const precision_t precision;
+	const summation_t summation;
+	const threshold_t threshold;
 
- 	std::shared_ptr<ResponseEVTDistribution> high_gpd;
-	std::shared_ptr<ResponseEVTDistribution> low_gpd;
+	std::shared_ptr<ResultCache> cache;
+
+	/** The low and high bounds of the last analysis, always replaced together */
+	struct Bounds {
+		std::shared_ptr<ResponseEVTDistribution> low;
+		std::shared_ptr<ResponseEVTDistribution> high;
+	};
+
+	std::shared_ptr<const Bounds> bounds;
 
 	T get_wcet_at_p(double p, double mu, double sigma, double xi) const;
 
+	// The samples are copied by the library through copy_values(), so that the instrumentation of
+	// the analysis (which depends on the build flags of the library) is never compiled in the
+	// code of the users.
+	typedef void (*copy_t)(const void *values, size_t size, BSCWorkspace<T> &ws, bool mixed);
+
+	template <typename U>
+	static void copy_values(const void *values, size_t size, BSCWorkspace<T> &ws, bool mixed) {
+		const U *first = static_cast<const U*>(values);
+		if(mixed) {
+			ws.bulk.assign(first, first + size);
+		} else {
+			ws.trace.assign(first, first + size);
+		}
+	}
+
+	void analyze_trace(const void *values, size_t size, copy_t copy, BSCWorkspace<T> &ws,
+	                   const AnalysisControl &control) const;
+	int select_tail_size(const std::vector<T> &trace_sorted, int half_size,
+	                     const AnalysisControl &control) const;
+	int select_tail_size_mixed(const std::vector<double> &trace_sorted, int half_size,
+	                           const AnalysisControl &control) const;
+	template <typename U>
+	int select_tail_size_mrl(const std::vector<U> &trace_sorted, int half_size,
+	                         const AnalysisControl &control) const;
+	void fit_tail(const std::vector<T> &trace_sorted, int nelems, BSCWorkspace<T> &ws,
+	              const AnalysisControl &control) const;
+	void set_bounds(const BSCWorkspace<T> &ws);
+	[[noreturn]] void throw_minvalues_error(int nelems, size_t samples) const;
+
+	std::shared_ptr<Response> restore_from_cache(const EVTRecord &record, size_t samples);
+	void set_bounds(std::shared_ptr<ResponseEVTDistribution> low,
+	                std::shared_ptr<ResponseEVTDistribution> high);
+	void store_to_cache(uint64_t key, const ResponseEVTDistribution &gpd,
+	                    const ResponseEVTDistribution &low, const ResponseEVTDistribution &high) const;
+
 };
 
 
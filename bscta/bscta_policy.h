@@ -0,0 +1,117 @@
+/** @file bscta_policy.h
+ * Compile-time configuration of the BSC timing analyzer.
+ *
+ * The confidence level of the analysis and the minimum number of tail samples are template
+ * parameters of BSCTimingAnalyzer, packed in a policy. The critical value of the standard normal
+ * distribution and the table of the half-widths z/sqrt(k) of the confidence intervals are
+ * computed by the compiler, so changing the confidence level has no runtime cost.
+ */
+
+#ifndef BSCTA_POLICY_H_
+#define BSCTA_POLICY_H_
+
+#include <cmath>
+
+namespace libta {
+
+/** @brief Square root usable in constant expressions (Newton's method) */
+constexpr long double constexpr_sqrt(long double v) {
+	if(v <= 0) {
+		return 0;
+	}
+	long double x = v > 1 ? v : 1;
+	for(int i = 0; i < 200; i++) {
+		const long double next = (x + v / x) / 2;
+		if(next >= x) {
+			break;
+		}
+		x = next;
+	}
+	return x;
+}
+
+/** @brief CDF of the standard normal distribution usable in constant expressions */
+constexpr long double constexpr_normal_cdf(long double x) {
+	// erf(x/sqrt(2)) with its Taylor series, accurate for the |x| < 6 of interest here
+	const long double y = x / constexpr_sqrt(2.0L);
+	long double term = y;
+	long double sum = y;
+	for(int n = 1; n < 500; n++) {
+		term *= -y * y / n;
+		const long double add = term / (2 * n + 1);
+		sum += add;
+		if(add < 1e-21L && add > -1e-21L) {
+			break;
+		}
+	}
+	return 0.5L + sum / constexpr_sqrt(3.14159265358979323846264338327950288L);
+}
+
+/** @brief Quantile of the standard normal distribution usable in constant expressions */
+constexpr long double constexpr_normal_quantile(long double p) {
+	long double low = -6, high = 6;
+	for(int i = 0; i < 100; i++) {
+		const long double mid = (low + high) / 2;
+		if(constexpr_normal_cdf(mid) < p) {
+			low = mid;
+		} else {
+			high = mid;
+		}
+	}
+	return (low + high) / 2;
+}
+
+/**
+ * @brief The configuration of BSCTimingAnalyzer
+ * @tparam ConfidencePermille  The two-sided confidence level of the CV test and of the
+ *                             distribution bounds, in thousandths
+ * @tparam MinTail             The minimum number of tail samples required to fit the tail
+ */
+template <int ConfidencePermille = 950, int MinTail = 10>
+struct BSCPolicy {
+	static_assert(ConfidencePermille > 0 && ConfidencePermille < 1000, "Invalid confidence level");
+	static_assert(MinTail >= 2, "At least 2 tail samples are required");
+
+	static constexpr long double confidence = ConfidencePermille / 1000.0L;
+	static constexpr int min_tail = MinTail;
+	/** @brief The critical value: P(|Z| <= z) = confidence for a standard normal Z */
+	static constexpr long double z = constexpr_normal_quantile(0.5L + confidence / 2);
+};
+
+template <int C, int M> constexpr long double BSCPolicy<C, M>::confidence;
+template <int C, int M> constexpr int BSCPolicy<C, M>::min_tail;
+template <int C, int M> constexpr long double BSCPolicy<C, M>::z;
+
+typedef BSCPolicy<900> BSCPolicy90;
+typedef BSCPolicy<950> BSCPolicy95;
+typedef BSCPolicy<990> BSCPolicy99;
+
+/**
+ * @brief The half-widths z/sqrt(k) of the confidence intervals estimated from k samples
+ *
+ * The first SIZE values are computed at compile time, the others on request.
+ */
+template <typename Policy>
+struct BSCLimits {
+	static constexpr int SIZE = 1024;
+
+	long double half_width[SIZE];
+
+	constexpr BSCLimits() : half_width() {
+		for(int k = 1; k < SIZE; k++) {
+			half_width[k] = Policy::z / constexpr_sqrt(k);
+		}
+	}
+
+	inline long double get(int k) const noexcept {
+		return k < SIZE ? half_width[k] : Policy::z / std::sqrt(static_cast<long double>(k));
+	}
+};
+
+/** @brief The table of the half-widths of a policy, computed once by the compiler */
+template <typename Policy>
+constexpr BSCLimits<Policy> bsc_limits{};
+
+}	// namespace libta
+
+#endif
@@ -0,0 +1,179 @@
+#include "libta_c.h"
+#include "bscta.h"
+
+#include <memory>
+#include <new>
+
+using libta::BSCTimingAnalyzer;
+using libta::BSCWorkspace;
+using libta::ResponseEVTDistribution;
+using libta::TimingAnalyzerError;
+
+// The analysis is always performed in double precision: the integer samples are converted while
+// they are copied into the workspace, which happens anyway.
+struct libta_analyzer_s {
+	libta_sample_type_t sample_type;
+	int rank_length;
+	BSCTimingAnalyzer<double> analyzer;
+
+	libta_analyzer_s(libta_sample_type_t sample_type, int rank_length)
+		: sample_type(sample_type), rank_length(rank_length), analyzer(rank_length) {}
+};
+
+struct libta_workspace_s {
+	libta_sample_type_t sample_type;
+	BSCWorkspace<double> ws;
+};
+
+namespace {
+
+libta_status_t to_status(libta::error_t error) noexcept {
+	switch(error) {
+		case libta::error_t::INVALID_DATA:
+			return LIBTA_E_INVALID_DATA;
+		case libta::error_t::INVALID_DISTRIBUTION:
+			return LIBTA_E_INVALID_DISTRIBUTION;
+		case libta::error_t::CANCELLED:
+			return LIBTA_E_CANCELLED;
+		case libta::error_t::DEADLINE_EXPIRED:
+			return LIBTA_E_DEADLINE_EXPIRED;
+	}
+	return LIBTA_E_INTERNAL;
+}
+
+void to_params(const ResponseEVTDistribution::parameters_t &p, libta_params_t &out) noexcept {
+	out.mu        = std::get<ResponseEVTDistribution::P_MU>(p);
+	out.sigma     = std::get<ResponseEVTDistribution::P_SIGMA>(p);
+	out.xi        = std::get<ResponseEVTDistribution::P_XI>(p);
+	out.threshold = std::get<ResponseEVTDistribution::P_THRSH>(p);
+}
+
+template <typename U>
+libta_status_t analyze(const libta_analyzer_t *analyzer, libta_workspace_t *workspace,
+                       libta_sample_type_t sample_type, const U *samples, size_t size,
+                       libta_result_t *result) noexcept {
+	if(analyzer == nullptr || workspace == nullptr || analyzer->sample_type != sample_type
+	   || workspace->sample_type != sample_type) {
+		return LIBTA_E_INVALID_ARGUMENT;
+	}
+	if(samples == nullptr || result == nullptr) {
+		return LIBTA_E_INVALID_ARGUMENT;
+	}
+
+	BSCWorkspace<double> &ws = workspace->ws;
+	try {
+		analyzer->analyzer.perform_analysis(samples, size, ws);
+	} catch(const TimingAnalyzerError &e) {
+		return to_status(e.get_type());
+	} catch(const std::bad_alloc &) {
+		return LIBTA_E_NO_MEMORY;
+	} catch(...) {
+		return LIBTA_E_INTERNAL;
+	}
+
+	result->dist_type = static_cast<libta_dist_type_t>(ws.get_result().get_dist_type());
+	to_params(ws.get_result().get_parameters(), result->params);
+	to_params(ws.get_low_gpd().get_parameters(), result->low);
+	to_params(ws.get_high_gpd().get_parameters(), result->high);
+	result->samples      = ws.get_stats().samples;
+	result->tail_samples = ws.get_stats().nelems;
+	return LIBTA_OK;
+}
+
+}	// namespace
+
+extern "C" {
+
+libta_status_t libta_analyzer_create(libta_sample_type_t sample_type, int rank_length,
+                                     libta_analyzer_t **analyzer) {
+	if(analyzer == nullptr || rank_length < 0
+	   || (sample_type != LIBTA_SAMPLES_U64 && sample_type != LIBTA_SAMPLES_DOUBLE)) {
+		return LIBTA_E_INVALID_ARGUMENT;
+	}
+
+	try {
+		*analyzer = new libta_analyzer_t(sample_type, rank_length == 0 ? 90000 : rank_length);
+	} catch(const std::bad_alloc &) {
+		return LIBTA_E_NO_MEMORY;
+	}
+	return LIBTA_OK;
+}
+
+void libta_analyzer_destroy(libta_analyzer_t *analyzer) {
+	delete analyzer;
+}
+
+libta_status_t libta_workspace_create(const libta_analyzer_t *analyzer, size_t max_samples,
+                                      libta_workspace_t **workspace) {
+	if(analyzer == nullptr || workspace == nullptr) {
+		return LIBTA_E_INVALID_ARGUMENT;
+	}
+
+	try {
+		std::unique_ptr<libta_workspace_t> w(new libta_workspace_t());
+		w->sample_type = analyzer->sample_type;
+		w->ws.reserve(max_samples, analyzer->rank_length);
+		*workspace = w.release();
+	} catch(const std::bad_alloc &) {
+		return LIBTA_E_NO_MEMORY;
+	} catch(const std::length_error &) {
+		return LIBTA_E_INVALID_ARGUMENT;
+	}
+	return LIBTA_OK;
+}
+
+void libta_workspace_destroy(libta_workspace_t *workspace) {
+	delete workspace;
+}
+
+libta_status_t libta_analyze_u64(const libta_analyzer_t *analyzer, libta_workspace_t *workspace,
+                                 const uint64_t *samples, size_t size, libta_result_t *result) {
+	return analyze(analyzer, workspace, LIBTA_SAMPLES_U64, samples, size, result);
+}
+
+libta_status_t libta_analyze_double(const libta_analyzer_t *analyzer, libta_workspace_t *workspace,
+                                    const double *samples, size_t size, libta_result_t *result) {
+	return analyze(analyzer, workspace, LIBTA_SAMPLES_DOUBLE, samples, size, result);
+}
+
+libta_status_t libta_quantile(libta_dist_type_t dist_type, const libta_params_t *params, double p,
+                              double *value) {
+	if(params == nullptr || value == nullptr || !(p > 0. && p < 1.)
+	   || dist_type < LIBTA_EVT_GEV || dist_type > LIBTA_EVT_GPD_3PARAM) {
+		return LIBTA_E_INVALID_ARGUMENT;
+	}
+
+	try {
+		*value = ResponseEVTDistribution::quantile(static_cast<libta::distribution_type_t>(dist_type),
+		                                           std::make_tuple(params->mu, params->sigma,
+		                                                           params->xi, params->threshold),
+		                                           p);
+	} catch(const std::invalid_argument &) {
+		return LIBTA_E_INVALID_ARGUMENT;
+	}
+	return LIBTA_OK;
+}
+
+const char *libta_status_string(libta_status_t status) {
+	switch(status) {
+		case LIBTA_OK:
+			return "Success";
+		case LIBTA_E_INVALID_ARGUMENT:
+			return "Invalid argument";
+		case LIBTA_E_INVALID_DATA:
+			return "The samples do not allow the analysis";
+		case LIBTA_E_INVALID_DISTRIBUTION:
+			return "Invalid distribution";
+		case LIBTA_E_CANCELLED:
+			return "Analysis cancelled";
+		case LIBTA_E_DEADLINE_EXPIRED:
+			return "Analysis deadline expired";
+		case LIBTA_E_NO_MEMORY:
+			return "Out of memory";
+		case LIBTA_E_INTERNAL:
+			return "Internal error";
+	}
+	return "Unknown status";
+}
+
+}	// extern "C"
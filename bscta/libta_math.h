@@ -1,7 +1,10 @@
 #ifndef LIBTA_MATH_H_
 #define LIBTA_MATH_H_
 
+#include <cassert>
 #include <cmath>
+#include <type_traits>
+#include <vector>
 
 namespace libta {
 
@@ -23,18 +26,180 @@ namespace libta {
         return std::is_same<T, long double>::value ? sqrtl(v) : sqrt(v);
     }
 
+    /**
+    * @brief The algorithm used to sum long sequences of samples
+    *
+    */
+    typedef enum class summation_e {
+        NAIVE,      /**< Left to right: the error grows with the number of values */
+        KAHAN,      /**< Kahan compensated summation */
+        NEUMAIER,   /**< Neumaier compensated summation, also correct when the values are larger
+                         than the partial sum */
+        PAIRWISE    /**< Pairwise summation: the error grows with the logarithm of the values */
+    } summation_t;
+
+    /**
+    * @brief Kahan compensated summation: the rounding error of every addition is carried to the
+    *        next one, so the error does not grow with the number of values
+    *
+    */
+    template <typename T>
+    class KahanSum {
+    public:
+        inline void add(T v) noexcept {
+            const T y = v - compensation;
+            const T t = sum + y;
+            compensation = (t - sum) - y;
+            sum = t;
+        }
+
+        inline T get() const noexcept {
+            return sum - compensation;
+        }
+
+    private:
+        T sum = 0;
+        T compensation = 0;
+    };
+
+    /**
+    * @brief Neumaier compensated summation: the rounding error of every addition is accumulated
+    *        separately, so the sum is as accurate as if computed in twice the precision
+    *
+    */
+    template <typename T>
+    class NeumaierSum {
+    public:
+        inline void add(T v) noexcept {
+            const T t = sum + v;
+            // Both errors are computed and one is selected, so that the loop has no branch
+            const T error = std::abs(sum) >= std::abs(v) ? (sum - t) + v : (v - t) + sum;
+            compensation += error;
+            sum = t;
+        }
+
+        inline T get() const noexcept {
+            return sum + compensation;
+        }
+
+    private:
+        T sum = 0;
+        T compensation = 0;
+    };
+
+    // The kernels below sum f(v[i]) with SUM_LANES independent accumulators, which the compiler
+    // maps to the lanes of the vector registers. Integer types are always summed exactly.
+    static constexpr size_t SUM_LANES = 8;
+    static constexpr size_t PAIRWISE_BLOCK = 128;
+
+    /**
+    * @brief Left to right summation, one chain per lane
+    *
+    */
+    template <typename T, typename F>
+    T laneSum(const T *v, size_t n, F f) {
+        T acc[SUM_LANES] = {};
+        size_t i = 0;
+        for(; i + SUM_LANES <= n; i += SUM_LANES) {
+            for(size_t l = 0; l < SUM_LANES; l++) {
+                acc[l] += f(v[i + l]);
+            }
+        }
+        for(; i < n; i++) {
+            acc[0] += f(v[i]);
+        }
+        T result = 0;
+        for(size_t l = 0; l < SUM_LANES; l++) {
+            result += acc[l];
+        }
+        return result;
+    }
+
+    /**
+    * @brief Compensated summation with the accumulator Acc, one accumulator per lane
+    *
+    */
+    template <typename T, typename Acc, typename F>
+    T compensatedSum(const T *v, size_t n, F f) {
+        Acc acc[SUM_LANES];
+        size_t i = 0;
+        for(; i + SUM_LANES <= n; i += SUM_LANES) {
+            for(size_t l = 0; l < SUM_LANES; l++) {
+                acc[l].add(f(v[i + l]));
+            }
+        }
+        for(; i < n; i++) {
+            acc[0].add(f(v[i]));
+        }
+        Acc result;
+        for(size_t l = 0; l < SUM_LANES; l++) {
+            result.add(acc[l].get());
+        }
+        return result.get();
+    }
+
+    /**
+    * @brief Pairwise summation: blocks of PAIRWISE_BLOCK values are summed per lane, then the
+    *        halves are summed recursively
+    *
+    */
+    template <typename T, typename F>
+    T pairwiseSum(const T *v, size_t n, F f) {
+        if(n <= PAIRWISE_BLOCK) {
+            return laneSum(v, n, f);
+        }
+        const size_t half = n / 2;
+        return pairwiseSum(v, half, f) + pairwiseSum(v + half, n - half, f);
+    }
+
+    template <typename T, typename F>
+    T sumOf(const T *v, size_t n, F f, summation_t summation, std::true_type /* floating */) {
+        switch(summation) {
+            case summation_t::KAHAN:
+                return compensatedSum<T, KahanSum<T>>(v, n, f);
+            case summation_t::NEUMAIER:
+                return compensatedSum<T, NeumaierSum<T>>(v, n, f);
+            case summation_t::PAIRWISE:
+                return pairwiseSum(v, n, f);
+            case summation_t::NAIVE:
+                break;
+        }
+        T result = 0;
+        for(size_t i = 0; i < n; i++) {
+            result += f(v[i]);
+        }
+        return result;
+    }
+
+    template <typename T, typename F>
+    T sumOf(const T *v, size_t n, F f, summation_t, std::false_type /* floating */) {
+        T result = 0;
+        for(size_t i = 0; i < n; i++) {
+            result += f(v[i]);
+        }
+        return result;
+    }
+
+    /**
+    * @brief Return the sum of f(v[i]) for the n values in v with the given algorithm
+    *
+    */
+    template <typename T, typename F>
+    inline T sumOf(const T *v, size_t n, F f, summation_t summation) {
+        return sumOf(v, n, f, summation, std::is_floating_point<T>());
+    }
+
     /**
     * @brief Return the mean of the vector obtained by subtracting v.last to all the elements of v
     *
     */
     template <typename T>
-    T getUnbiasedMean(const std::vector<T> &v, size_t start, size_t size) {
+    T getUnbiasedMean(const std::vector<T> &v, size_t start, size_t size,
+                      summation_t summation = summation_t::NAIVE) {
         assert(start+size <= v.size());
-        assert(start+size-1 >= 0);
-        T result=0;
-        for(size_t i=start; i<start+size; i++) {
-            result+=(v[i]-v[start+size-1]);
-        }
+        assert(size > 0);
+        const T last = v[start+size-1];
+        const T result = sumOf(&v[start], size, [last](T x) { return x - last; }, summation);
         return result/size;
     }
 
@@ -43,27 +208,20 @@ namespace libta {
     *
     */
     template <typename T>
-    T getUnbiasedStdDeviation(const std::vector<T> &v, size_t start, size_t size) {
+    T getUnbiasedStdDeviation(const std::vector<T> &v, size_t start, size_t size,
+                              summation_t summation = summation_t::NAIVE) {
         assert(start+size <= v.size());
-        assert(start+size-1 >= 0);
-        T sumOfSquares=0;
-        T sumOfValues=0;
-        for(size_t i=start; i<start+size; i++) {
-            const T delta=v[i] - v[start+size-1];
-            sumOfValues+= delta;
-            //sumOfSquares+=(delta*delta);
-        }
-        T mean=sumOfValues/size;
-        
-        for(size_t i=start; i<start+size; i++) {
-            const T delta=v[i] - v[start+size-1];
-            sumOfSquares+= internalPow<T>(delta-mean,2);
-        }
-        //return internalSqrt<T>( sumOfSquares/(size-1)-internalPow<T>(sumOfValues,2)/((size-1)*size) );
+        assert(size > 0);
+        const T last = v[start+size-1];
+        const T sumOfValues = sumOf(&v[start], size, [last](T x) { return x - last; }, summation);
+        const T mean=sumOfValues/size;
+
+        const T sumOfSquares = sumOf(&v[start], size, [last, mean](T x) {
+            const T delta = (x - last) - mean;
+            return delta * delta;
+        }, summation);
         return internalSqrt<T>( sumOfSquares/(size-1));
-    
     }
-    
 
     /**
     * @brief fill vec in starting from start and increasing of step
@@ -111,19 +269,21 @@ namespace libta {
 
         const T sum= setExponProbabilyDensityFunction(dest, src,  rate);
         const int size = dest.size();
-        {   //Scope to limit tmp
-            std::vector<T> tmp = dest ; 
-            dest[0] = 0;
-            for(int i=1;i<size;i++){
-                 dest[i] = dest[i-1] + tmp[i-1]/sum;
-            }
-    
-            for(int i=0; i<size;i++){
-                T tmpvalue = 1 - dest[i];
-                if(tmpvalue <= 0 ) dest[i] = 0;
-                else dest[i] = tmpvalue; 
-            }
-      }
+
+        //Cumulative sum computed in place: the density of the previous element is kept aside,
+        //so that no temporary copy of dest is needed
+        T cumulative = 0;
+        for(int i=0;i<size;i++){
+            const T density = dest[i];
+            dest[i] = cumulative;
+            cumulative = cumulative + density/sum;
+        }
+
+        for(int i=0; i<size;i++){
+            T tmpvalue = 1 - dest[i];
+            if(tmpvalue <= 0 ) dest[i] = 0;
+            else dest[i] = tmpvalue; 
+        }
 
     }
 };
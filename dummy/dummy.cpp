@@ -41,6 +41,12 @@ int main() {
 
     std::cout << "WCET Value: " << rwcet->get_wcet_value() << std::endl;
 
+    // Or, without heap allocations and dynamic casts:
+    AnalysisResult<unsigned long> result = mta.analyze(*req);
+    if (result.is_wcet()) {
+        std::cout << "WCET Value: " << result.get_wcet_value() << std::endl;
+    }
+
 }
 
 */
\ No newline at end of file
@@ -0,0 +1,42 @@
+#include "eval.h"
+#include "bscta.h"
+
+namespace libta {
+
+namespace eval {
+
+namespace {
+
+template <typename T>
+Backend make_backend(const std::string &name, precision_t precision = precision_t::NATIVE,
+                     summation_t summation = summation_t::NAIVE,
+                     threshold_t threshold = threshold_t::CV_CONE) {
+	return Backend{name, [precision, summation, threshold](const std::vector<double> &trace)
+	                                                       -> analysis_t {
+		// The raw-array analysis reads the trace as it is
+		return [precision, summation, threshold, &trace](const std::vector<double> &probabilities,
+		                                                 std::vector<double> &quantiles) {
+			BSCTimingAnalyzer<T> analyzer(90000, precision, summation, threshold);
+			BSCWorkspace<T> ws;
+			analyzer.perform_analysis(trace.data(), trace.size(), ws);
+			for(double p : probabilities) {
+				quantiles.push_back(ws.get_result().get_quantile(1 - p));
+			}
+		};
+	}};
+}
+
+}	// namespace
+
+std::vector<Backend> get_backends() {
+	return {
+		make_backend<double>("bscta"),
+		make_backend<long double>("bscta-long-double-mixed", precision_t::MIXED),
+		make_backend<float>("bscta-float-neumaier", precision_t::NATIVE, summation_t::NEUMAIER),
+		make_backend<double>("bscta-mrl", precision_t::NATIVE, summation_t::NAIVE, threshold_t::MRL),
+	};
+}
+
+}	// namespace eval
+
+}	// namespace libta
@@ -0,0 +1,35 @@
+#include "eval.h"
+#include "chronovise.h"
+
+#include <cmath>
+#include <stdexcept>
+
+namespace libta {
+
+namespace eval {
+
+std::vector<Backend> get_backends() {
+	return {
+		Backend{"chronovise", [](const std::vector<double> &trace) -> analysis_t {
+			auto req = std::make_shared<Request<unsigned long>>();
+			for(double v : trace) {
+				req->add_value(static_cast<unsigned long>(std::llround(v)));
+			}
+			return [req](const std::vector<double> &probabilities, std::vector<double> &quantiles) {
+				ChronoviseTimingAnalyzer analyzer;
+				auto dist = std::dynamic_pointer_cast<ResponseEVTDistribution>(
+				                                                    analyzer.perform_analysis(req));
+				if(! dist) {
+					throw std::runtime_error("No distribution estimated.");
+				}
+				for(double p : probabilities) {
+					quantiles.push_back(dist->get_quantile(1 - p));
+				}
+			};
+		}},
+	};
+}
+
+}	// namespace eval
+
+}	// namespace libta
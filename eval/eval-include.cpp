@@ -0,0 +1,39 @@
+// The DistributionAnalyzer of include/libta, which cannot share a translation unit with the
+// libta.h of the implementations
+#include "eval.h"
+#include "libta/libta.h"
+
+#include <stdexcept>
+
+namespace libta {
+
+namespace eval {
+
+std::vector<Backend> get_backends() {
+	return {
+		Backend{"include-distribution-analyzer", [](const std::vector<double> &trace) -> analysis_t {
+			auto req = std::make_shared<Request<double>>();
+			for(double v : trace) {
+				req->add_value(v);
+			}
+			return [req](const std::vector<double> &probabilities, std::vector<double> &quantiles) {
+				DistributionAnalyzer<double> analyzer;
+				auto result = analyzer.estimate_distribution(req);
+				if(result.isLeft) {
+					throw std::runtime_error(result.leftValue.get_message());
+				}
+				for(double p : probabilities) {
+					auto pwcet = result.rightValue->getPWCET(p);
+					if(pwcet.isLeft) {
+						throw std::runtime_error(pwcet.leftValue.get_message());
+					}
+					quantiles.push_back(pwcet.rightValue.pWCET);
+				}
+			};
+		}},
+	};
+}
+
+}	// namespace eval
+
+}	// namespace libta
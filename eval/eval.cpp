@@ -0,0 +1,442 @@
+#include "eval.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <new>
+#include <random>
+#include <sstream>
+
+// ------------------------------- HEAP ACCOUNTING -------------------------------
+//
+// The global allocation functions are replaced to measure the peak heap memory of the analyses:
+// every block is prefixed with its size, so that the released bytes are known.
+
+namespace {
+
+constexpr size_t HEADER = alignof(std::max_align_t);
+
+std::atomic<size_t> current_bytes(0);
+std::atomic<size_t> peak_bytes(0);
+std::atomic<size_t> allocations(0);
+
+void *allocate(size_t size) noexcept {
+	char *block = static_cast<char*>(std::malloc(size + HEADER));
+	if(block == nullptr) {
+		return nullptr;
+	}
+	*reinterpret_cast<size_t*>(block) = size;
+
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	const size_t current = current_bytes.fetch_add(size, std::memory_order_relaxed) + size;
+	size_t peak = peak_bytes.load(std::memory_order_relaxed);
+	while(current > peak
+	      && ! peak_bytes.compare_exchange_weak(peak, current, std::memory_order_relaxed)) {
+	}
+	return block + HEADER;
+}
+
+void release(void *ptr) noexcept {
+	if(ptr == nullptr) {
+		return;
+	}
+	char *block = static_cast<char*>(ptr) - HEADER;
+	current_bytes.fetch_sub(*reinterpret_cast<size_t*>(block), std::memory_order_relaxed);
+	std::free(block);
+}
+
+}	// namespace
+
+void *operator new(size_t size) {
+	void *ptr = allocate(size);
+	if(ptr == nullptr) {
+		throw std::bad_alloc();
+	}
+	return ptr;
+}
+
+void *operator new[](size_t size) {
+	return operator new(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+	return allocate(size);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept {
+	return allocate(size);
+}
+
+void operator delete(void *ptr) noexcept {
+	release(ptr);
+}
+
+void operator delete[](void *ptr) noexcept {
+	release(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept {
+	release(ptr);
+}
+
+void operator delete[](void *ptr, size_t) noexcept {
+	release(ptr);
+}
+
+void operator delete(void *ptr, const std::nothrow_t &) noexcept {
+	release(ptr);
+}
+
+void operator delete[](void *ptr, const std::nothrow_t &) noexcept {
+	release(ptr);
+}
+
+namespace libta {
+
+namespace eval {
+
+namespace {
+
+// ------------------------------- TRACE MODELS -------------------------------
+
+/** @brief P(Z > z) = p for a standard normal Z, by bisection on erfc */
+double normal_upper_quantile(double p) {
+	double low = -40, high = 40;
+	for(int i = 0; i < 200; i++) {
+		const double mid = (low + high) / 2;
+		if(0.5 * std::erfc(mid / std::sqrt(2.)) > p) {
+			low = mid;
+		} else {
+			high = mid;
+		}
+	}
+	return (low + high) / 2;
+}
+
+/** @brief A synthetic distribution of execution times */
+class Model {
+public:
+	virtual ~Model() = default;
+	virtual const char *name() const = 0;
+	virtual void generate(size_t n, std::mt19937_64 &rng, std::vector<double> &out) const = 0;
+	/** @brief The execution time exceeded with probability p */
+	virtual double quantile(double p) const = 0;
+};
+
+class ExponentialModel : public Model {
+public:
+	const char *name() const override { return "exponential"; }
+
+	void generate(size_t n, std::mt19937_64 &rng, std::vector<double> &out) const override {
+		std::exponential_distribution<double> dist(1. / scale);
+		for(size_t i = 0; i < n; i++) {
+			out.push_back(offset + dist(rng));
+		}
+	}
+
+	double quantile(double p) const override {
+		return offset - scale * std::log(p);
+	}
+
+private:
+	static constexpr double offset = 1000., scale = 50.;
+};
+
+class WeibullModel : public Model {
+public:
+	const char *name() const override { return "weibull"; }
+
+	void generate(size_t n, std::mt19937_64 &rng, std::vector<double> &out) const override {
+		std::weibull_distribution<double> dist(shape, scale);
+		for(size_t i = 0; i < n; i++) {
+			out.push_back(offset + dist(rng));
+		}
+	}
+
+	double quantile(double p) const override {
+		return offset + scale * std::pow(-std::log(p), 1. / shape);
+	}
+
+private:
+	static constexpr double offset = 1000., shape = 1.5, scale = 100.;
+};
+
+class ParetoModel : public Model {
+public:
+	const char *name() const override { return "pareto"; }
+
+	void generate(size_t n, std::mt19937_64 &rng, std::vector<double> &out) const override {
+		std::uniform_real_distribution<double> dist(0., 1.);
+		for(size_t i = 0; i < n; i++) {
+			out.push_back(scale * std::pow(1. - dist(rng), -1. / alpha));
+		}
+	}
+
+	double quantile(double p) const override {
+		return scale * std::pow(p, -1. / alpha);
+	}
+
+private:
+	static constexpr double scale = 1000., alpha = 3.;
+};
+
+/** @brief A fast mode with a slow minority, e.g. cache hits and misses */
+class NormalMixtureModel : public Model {
+public:
+	const char *name() const override { return "normal-mixture"; }
+
+	void generate(size_t n, std::mt19937_64 &rng, std::vector<double> &out) const override {
+		std::bernoulli_distribution slow(weight);
+		std::normal_distribution<double> fast_dist(mu1, sigma1), slow_dist(mu2, sigma2);
+		for(size_t i = 0; i < n; i++) {
+			out.push_back(slow(rng) ? slow_dist(rng) : fast_dist(rng));
+		}
+	}
+
+	double quantile(double p) const override {
+		const auto survival = [](double x) {
+			return (1 - weight) * 0.5 * std::erfc((x - mu1) / (sigma1 * std::sqrt(2.)))
+			       + weight * 0.5 * std::erfc((x - mu2) / (sigma2 * std::sqrt(2.)));
+		};
+		double low = mu1, high = mu2 + 40 * sigma2;
+		for(int i = 0; i < 200; i++) {
+			const double mid = (low + high) / 2;
+			if(survival(mid) > p) {
+				low = mid;
+			} else {
+				high = mid;
+			}
+		}
+		return (low + high) / 2;
+	}
+
+private:
+	static constexpr double weight = 0.1;
+	static constexpr double mu1 = 1000., sigma1 = 20., mu2 = 1100., sigma2 = 30.;
+};
+
+/** @brief A Gaussian AR(1) series: the samples are correlated, the marginal is N(mu, sigma) */
+class AutoregressiveModel : public Model {
+public:
+	const char *name() const override { return "ar1"; }
+
+	void generate(size_t n, std::mt19937_64 &rng, std::vector<double> &out) const override {
+		std::normal_distribution<double> noise(0., sigma * std::sqrt(1 - phi * phi));
+		std::normal_distribution<double> first(0., sigma);
+		double x = first(rng);
+		for(size_t i = 0; i < n; i++) {
+			out.push_back(mu + x);
+			x = phi * x + noise(rng);
+		}
+	}
+
+	double quantile(double p) const override {
+		return mu + sigma * normal_upper_quantile(p);
+	}
+
+private:
+	static constexpr double mu = 1000., sigma = 25., phi = 0.8;
+};
+
+constexpr double ExponentialModel::offset, ExponentialModel::scale;
+constexpr double WeibullModel::offset, WeibullModel::shape, WeibullModel::scale;
+constexpr double ParetoModel::scale, ParetoModel::alpha;
+constexpr double NormalMixtureModel::weight, NormalMixtureModel::mu1, NormalMixtureModel::sigma1,
+                 NormalMixtureModel::mu2, NormalMixtureModel::sigma2;
+constexpr double AutoregressiveModel::mu, AutoregressiveModel::sigma, AutoregressiveModel::phi;
+
+// ------------------------------- OUTPUT -------------------------------
+
+std::string json_string(const std::string &s) {
+	std::string out = "\"";
+	for(char c : s) {
+		if(c == '"' || c == '\\') {
+			out += '\\';
+			out += c;
+		} else if(static_cast<unsigned char>(c) < 0x20) {
+			char buf[8];
+			std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+			out += buf;
+		} else {
+			out += c;
+		}
+	}
+	return out + "\"";
+}
+
+std::string json_number(double v) {
+	if(! std::isfinite(v)) {
+		return "null";
+	}
+	char buf[32];
+	std::snprintf(buf, sizeof(buf), "%.17g", v);
+	return buf;
+}
+
+// ------------------------------- DRIVER -------------------------------
+
+struct Options {
+	std::vector<size_t> sizes = {1000, 10000, 100000};
+	std::vector<std::string> models;
+	int repeat = 3;
+	unsigned long seed = 1;
+	std::string label;
+};
+
+std::vector<std::string> split(const char *arg) {
+	std::vector<std::string> out;
+	std::stringstream ss(arg);
+	std::string item;
+	while(std::getline(ss, item, ',')) {
+		out.push_back(item);
+	}
+	return out;
+}
+
+[[noreturn]] void usage(const char *argv0) {
+	std::fprintf(stderr, "Usage: %s [--sizes N,N,...] [--models NAME,...] [--repeat N] "
+	                     "[--seed S] [--label TEXT]\n"
+	                     "Models: exponential, weibull, pareto, normal-mixture, ar1\n", argv0);
+	std::exit(2);
+}
+
+Options parse(int argc, char *argv[]) {
+	Options opt;
+	for(int i = 1; i < argc; i++) {
+		const std::string arg = argv[i];
+		if(i + 1 >= argc) {
+			usage(argv[0]);
+		}
+		const char *value = argv[++i];
+		if(arg == "--sizes") {
+			opt.sizes.clear();
+			for(const auto &s : split(value)) {
+				opt.sizes.push_back(std::strtoull(s.c_str(), nullptr, 10));
+			}
+		} else if(arg == "--models") {
+			opt.models = split(value);
+		} else if(arg == "--repeat") {
+			opt.repeat = std::max(1, std::atoi(value));
+		} else if(arg == "--seed") {
+			opt.seed = std::strtoul(value, nullptr, 10);
+		} else if(arg == "--label") {
+			opt.label = value;
+		} else {
+			usage(argv[0]);
+		}
+	}
+	return opt;
+}
+
+void run(const Options &opt, const Backend &backend, const Model &model, size_t size) {
+	// Every backend and size analyzes the same trace for a given seed
+	std::mt19937_64 rng(opt.seed);
+	std::vector<double> trace;
+	trace.reserve(size);
+	model.generate(size, rng, trace);
+
+	std::vector<double> probabilities;
+	for(int e = 3; e <= 12; e++) {
+		probabilities.push_back(std::pow(10., -e));
+	}
+	std::vector<double> quantiles;
+	quantiles.reserve(probabilities.size());
+
+	std::string error;
+	analysis_t analysis;
+	try {
+		analysis = backend.prepare(trace);
+	} catch(const std::exception &e) {
+		error = e.what();
+	}
+
+	long long best_ns = -1;
+	size_t peak = 0, count = 0;
+	for(int r = 0; r < opt.repeat && error.empty(); r++) {
+		quantiles.clear();
+		const size_t base = current_bytes.load();
+		peak_bytes.store(base);
+		const size_t base_count = allocations.load();
+
+		const auto start = std::chrono::steady_clock::now();
+		try {
+			analysis(probabilities, quantiles);
+		} catch(const std::exception &e) {
+			error = e.what();
+		}
+		const auto end = std::chrono::steady_clock::now();
+
+		const long long ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+		best_ns = best_ns < 0 ? ns : std::min(best_ns, ns);
+		peak = std::max(peak, peak_bytes.load() - base);
+		count = allocations.load() - base_count;
+	}
+
+	std::string line = "{\"label\":" + json_string(opt.label)
+	                 + ",\"backend\":" + json_string(backend.name)
+	                 + ",\"model\":" + json_string(model.name())
+	                 + ",\"samples\":" + std::to_string(size)
+	                 + ",\"seed\":" + std::to_string(opt.seed);
+	if(! error.empty() || quantiles.size() != probabilities.size()) {
+		line += ",\"status\":\"error\",\"message\":"
+		      + json_string(error.empty() ? "Wrong number of quantiles" : error) + "}";
+		std::printf("%s\n", line.c_str());
+		return;
+	}
+
+	line += ",\"status\":\"ok\",\"time_ns\":" + std::to_string(best_ns)
+	      + ",\"peak_bytes\":" + std::to_string(peak)
+	      + ",\"allocations\":" + std::to_string(count)
+	      + ",\"quantiles\":[";
+	for(size_t i = 0; i < probabilities.size(); i++) {
+		const double truth = model.quantile(probabilities[i]);
+		line += (i == 0 ? "{" : ",{");
+		line += "\"p\":" + json_number(probabilities[i])
+		      + ",\"true\":" + json_number(truth)
+		      + ",\"estimate\":" + json_number(quantiles[i])
+		      + ",\"rel_error\":" + json_number((quantiles[i] - truth) / truth) + "}";
+	}
+	line += "]}";
+	std::printf("%s\n", line.c_str());
+	std::fflush(stdout);
+}
+
+}	// namespace
+
+}	// namespace eval
+
+}	// namespace libta
+
+int main(int argc, char *argv[]) {
+	using namespace libta::eval;
+
+	const Options opt = parse(argc, argv);
+
+	std::vector<std::unique_ptr<Model>> models;
+	models.emplace_back(new ExponentialModel());
+	models.emplace_back(new WeibullModel());
+	models.emplace_back(new ParetoModel());
+	models.emplace_back(new NormalMixtureModel());
+	models.emplace_back(new AutoregressiveModel());
+
+	const std::vector<Backend> backends = get_backends();
+	for(const auto &model : models) {
+		if(! opt.models.empty()
+		   && std::find(opt.models.begin(), opt.models.end(), model->name()) == opt.models.end()) {
+			continue;
+		}
+		for(size_t size : opt.sizes) {
+			for(const auto &backend : backends) {
+				run(opt, backend, *model, size);
+			}
+		}
+	}
+	return 0;
+}
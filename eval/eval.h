@@ -0,0 +1,67 @@
+/** @file eval.h
+ * The accuracy-versus-cost evaluation harness.
+ *
+ * Every backend (an implementation of libta, or the DistributionAnalyzer of include/libta) is
+ * linked in its own executable, since the backends cannot share a translation unit. The common
+ * driver (eval.cpp) generates synthetic traces from distributions with known quantiles, runs
+ * the backends of the executable on them and prints one JSON object per line with the error of
+ * the estimated quantiles, the analysis time and the peak heap memory. The conversion of the
+ * trace to the input of a backend is excluded from the time and the memory.
+ *
+ * @copyright
+ * Copyright 2020 Politecnico di Milano
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef LIBTA_EVAL_H_
+#define LIBTA_EVAL_H_
+
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace libta {
+
+namespace eval {
+
+/**
+ * @brief Estimate the execution times exceeded with the given probabilities.
+ *
+ * The probabilities are passed to the backend as its users would, e.g. get_quantile(1 - p) for a
+ * ResponseEVTDistribution. Failures are reported by throwing any std::exception.
+ */
+typedef std::function<void(const std::vector<double> &probabilities,
+                           std::vector<double> &quantiles)> analysis_t;
+
+/**
+ * @brief Convert a trace to the input of the backend, e.g. a Request, and return its analysis.
+ *
+ * The conversion is not measured, so every backend is timed on the analysis of its own input
+ * format only. The returned analysis may refer to the trace, which outlives it.
+ */
+typedef std::function<analysis_t(const std::vector<double> &trace)> backend_t;
+
+struct Backend {
+	std::string name;
+	backend_t prepare;
+};
+
+/** @brief The backends of the executable, defined by its eval-<backend>.cpp */
+std::vector<Backend> get_backends();
+
+}	// namespace eval
+
+}	// namespace libta
+
+#endif // LIBTA_EVAL_H_
@@ -180,75 +180,85 @@ public:
 };
 
 
+/**
+ * @brief The tabulated form of an EVTDistribution, see EVTDistribution::tabulate()
+ *
+ */
+template <typename T>
+struct EVTTable {
+    std::vector<T> rank;            /*!< execution time associated to pWCET */
+    std::vector<T> pWCET;           /*!< pWCET (probability) */
+    std::vector<T> pWCETlow;        /*!< lower bound of pWCET */
+    std::vector<T> pWCEThigh;       /*!< upper bound of pWCET */
+};
+
 /**
  * @brief The class returned by the timing analysis tool when the output is the EVT distribution
  *
+ * The distribution is stored in parametric form: above the offset (the smallest tail value) the
+ * execution times are exponentially distributed with the given rate, and the bounds of the
+ * confidence interval are the exponential distributions with rates ratelow and ratehigh. The
+ * pWCETs are computed in closed form, so a distribution costs a few scalars plus the tail values
+ * instead of four tables of rank_length elements.
  */
 template <class T>
 class EVTDistribution {
 
 private:
-   neither::Either<ResponseInvalidDistribution,ResponsePWCET<T> > 
-   getPWCETInternal(T probability, const std::vector<T> & target) const {
+   neither::Either<ResponseInvalidDistribution,ResponsePWCET<T> >
+   getPWCETInternal(T probability, T rate) const {
         assert(probability >= 0);
         assert(probability <= 1);
-        assert(target.size() > 0);
 
-        auto positionIterator =std::lower_bound(target.begin(),target.end(),probability, std::greater<T>());
-        //Not found value. Need to fall back to last available element
-        if(positionIterator==target.end())
-          positionIterator--;
-        auto offset = positionIterator - target.begin();
-        return neither::right(ResponsePWCET<T>(rank[offset]) );
+        // P(X > x) = exp(-rate (x - offset)): a zero probability is never reached
+        if(probability <= 0)
+          return neither::left(ResponseInvalidDistribution());
+        return neither::right(ResponsePWCET<T>(offset - std::log(probability) / rate));
 
    }
 
 public:
 
     /**
-     * @brief The ResponseEVTDistribution class constructor
-     * @param dist_type  The subtype of EVT distribution (GEV/GPD)
+     * @brief The EVTDistribution class constructor
+     * @param dist_type    The subtype of EVT distribution
+     * @param _tailValues  The real values used for the tail estimation, in decreasing order
+     * @param offset       The threshold of the tail
+     * @param rate         The rate of the exponential tail
+     * @param ratelow      The rate of the lower bound (the larger one)
+     * @param ratehigh     The rate of the upper bound (the smaller one)
+     * @param rank_length  The default resolution of tabulate()
       */
     EVTDistribution(distribution_type_t dist_type, std::vector<T> _tailValues,
-                    std::vector<T> _rank, std::vector<T> _pWCET, std::vector<T> _pWCETlow, std::vector<T> _pWCEThigh )
-        : dist_type(dist_type), tailValues(_tailValues),
-          rank(_rank), pWCET(_pWCET), pWCETlow(_pWCETlow), pWCEThigh(_pWCEThigh)
+                    T offset, T rate, T ratelow, T ratehigh, int rank_length = 90000)
+        : dist_type(dist_type), tailValues(std::move(_tailValues)),
+          offset(offset), rate(rate), ratelow(ratelow), ratehigh(ratehigh),
+          rank_length(rank_length)
     {    }
 
     EVTDistribution() = delete;
 
-    EVTDistribution<T>& operator=(const EVTDistribution<T>& src) {
-        if(&src == this)
-            return *this;
-        dist_type = src.dist_type;
-        tailValues = src.tailValues;
-        pWCET = src.pWCET;
-        pWCETlow = src.pWCETlow;
-        pWCEThigh = src.pWCEThigh;
-        return *this;
-    }
-
     virtual ~EVTDistribution() = default;
 
     /**
      * @brief  get the execution time that exceeds with the given probability
      */
     neither::Either<ResponseInvalidDistribution,ResponsePWCET<T> > getPWCET(T probability) const {
-        return getPWCETInternal(probability, pWCET);
+        return getPWCETInternal(probability, rate);
     }
 
     /**
      * @brief  get the execution time that exceeds with the given probability with risky assumption
      */
     neither::Either<ResponseInvalidDistribution,ResponsePWCET<T> > getPWCETLow(T probability) const {
-        return getPWCETInternal(probability, pWCETlow);
+        return getPWCETInternal(probability, ratelow);
     }
 
      /**
      * @brief  get the execution time that exceeds with the given probability with safe assumption
      */
     neither::Either<ResponseInvalidDistribution,ResponsePWCET<T> > getPWCETHigh(T probability) const {
-        return getPWCETInternal(probability, pWCEThigh);
+        return getPWCETInternal(probability, ratehigh);
     }
 
     /**
@@ -261,18 +271,72 @@ public:
     /**
      * @brief  get the real values used for the tail estimation
      */
-    const std::vector<T> getTailValues() const {
+    const std::vector<T> &getTailValues() const {
         return tailValues;
     }
 
+    /** @brief Getter for the threshold of the tail */
+    T getOffset() const {
+        return offset;
+    }
+
+    /** @brief Getter for the rate of the exponential tail */
+    T getRate() const {
+        return rate;
+    }
+
+    /** @brief Getter for the rate of the lower bound */
+    T getRateLow() const {
+        return ratelow;
+    }
+
+    /** @brief Getter for the rate of the upper bound */
+    T getRateHigh() const {
+        return ratehigh;
+    }
+
+    /**
+     * @brief  export the survival functions sampled over rank_length execution times, from the
+     *         offset to 20 times the width of the tail above it
+     * @note   the table is discretized and normalized over the grid, so at moderate probabilities
+     *         its pWCETs differ from the closed-form ones by up to one grid step. The closed form
+     *         extends beyond the table instead, whose small probabilities are dominated by the
+     *         rounding of the normalization and which clamps at its last rank: at 1e-12 and below
+     *         the two diverge by tens to thousands of grid steps
+     */
+    EVTTable<T> tabulate() const {
+        return tabulate(this->rank_length);
+    }
+
+    EVTTable<T> tabulate(int rank_length) const {
+        assert(rank_length > 2);
+
+        EVTTable<T> table;
+        const T rank_end = 20 * (tailValues[0] - offset);
+        const T rank_start = 0 ;
+        const T rank_step = (rank_end - rank_start)/ (rank_length-1);
+        table.rank.assign(rank_length,0);
+        table.pWCET.assign(rank_length,0);
+        table.pWCETlow.assign(rank_length,0);
+        table.pWCEThigh.assign(rank_length,0);
+        arange(table.rank,rank_start,rank_step);
+
+        setExponSurvivalFunction(table.pWCET,table.rank, rate);
+        setExponSurvivalFunction(table.pWCETlow,table.rank, ratelow);
+        setExponSurvivalFunction(table.pWCEThigh,table.rank, ratehigh);
+        for( auto &v : table.rank )  v += offset;
+        return table;
+    }
+
 
 protected:
     distribution_type_t dist_type;  /*!< Type of the estimated distribution */
     std::vector<T> tailValues;      /*!< real values of the tail */
-    std::vector<T> rank;            /*!< execution time associated to pWCET */
-    std::vector<T> pWCET;           /*!< pWCET (probability) */
-    std::vector<T> pWCETlow;        /*!< lower bound of pWCET */
-    std::vector<T> pWCEThigh;       /*!< upper bound of pWCET */
+    T offset;                       /*!< threshold of the tail */
+    T rate;                         /*!< rate of the exponential tail */
+    T ratelow;                      /*!< rate of the lower bound */
+    T ratehigh;                     /*!< rate of the upper bound */
+    int rank_length;                /*!< default resolution of the tabulated form */
 };
 
 
@@ -340,15 +404,16 @@ public:
     /**
      * @brief Estimates the distribution from the given request
      *
+     * @param rank_length  The default resolution of EVTDistribution::tabulate()
      * @note changing rank_length to a to big value may produce wrong values for small probabilities
-     *       (1e-15). For double, do not exceed 1 Million
+     *       (1e-15) in the tabulated form. For double, do not exceed 1 Million
      */
     neither::Either<ResponseInvalidData,std::shared_ptr< EVTDistribution<T> > > estimate_distribution(std::shared_ptr<Request<T>> req, const int rank_length = 90000) {
 
         //Copy in vector and sort it
-        //std::vector<T> trace_sorted(req->cbegin(),req->cend());
         auto trace_sorted = req->get_all();
-        if(trace_sorted.size() <= 10 ) neither::left( ResponseInvalidData("The number of samples is '10' or less in the Request.\nPlease get more samples.\n") ); ;
+        if(trace_sorted.size() <= 10 )
+            return neither::left( ResponseInvalidData("The number of samples is '10' or less in the Request.\nPlease get more samples.\n") );
         std::sort(trace_sorted.begin(),trace_sorted.end(), std::greater<T>() );
 
         //Init Required stuff
@@ -356,36 +421,17 @@ public:
         const int half_size = floor(file_size/2);
         static const int minvalues = 10 ;
 
-        std::vector<T> cv(half_size-2);
-        std::vector<T> limitabove(half_size-2);
-        //std::vector<T> limitbelow(half_size-2);
-
         //Compute the CV = Coefficient of Variation. It is the std_dev/mean
-        //Need at lest 2 samples to compute the std_deviation
-        for(int rejectedSamples = 2; rejectedSamples < half_size; rejectedSamples++) {
-            int usedSamples=half_size - rejectedSamples;
+        //The CV of the top usedSamples values must stay inside the region of acceptance for the
+        //exponential tail (the red cone in a CV-plot). Starting from the smallest tail, the first
+        //value outside the cone stops the scan, so the remaining CVs are not computed at all.
+        int nelems =  0;
+        for(int usedSamples = 1; usedSamples <= half_size - 2; usedSamples++) {
             T mean = getUnbiasedMean(trace_sorted,0,usedSamples);
             T std_deviation = getUnbiasedStdDeviation(trace_sorted,0,usedSamples);
-            cv[rejectedSamples-2]= std_deviation/mean;
-        }
-        //Compute the region of acceptance for the exponential tail.
-        //This is the red cone in a CV-plot
-        //Impose the template enforce the type casting of the input
-        //assert(limitbelow.size() == limitabove.size());
-        for(size_t i=0; i<limitabove.size(); i++) {
-            T tmp = (1.96/internalSqrt<T>(half_size-i));
-            limitabove[i]=1 + tmp;
-            //limitbelow[i]=1 - tmp;
-        }
-
-        assert(limitabove.size() == cv.size());
-
-        int nelems =  0;
-        //Find the values below the limitabove starting from the end
-        for(size_t i=cv.size()-1; i>=0; i--) {
-                    //Impose the template enforce the type casting of the input
-            T upperLimit = 1 + (1.96/internalSqrt<T>(half_size-i));
-            if(cv[i]>=upperLimit)
+            //Impose the template enforce the type casting of the input
+            T upperLimit = 1 + (1.96/internalSqrt<T>(usedSamples + 2));
+            if(std_deviation/mean>=upperLimit)
                 break;
             nelems++;
         }
@@ -402,31 +448,10 @@ public:
         const T ratelow = rate * (1 + (1.96/internalSqrt<T>(nelems)));
         const T ratehigh = rate *(1 - (1.96/internalSqrt<T>(nelems)));
 
-        //Biggest value in nelems is the MET
-       // const T rank_end =20 * trace_sorted[0] ;
-
-        const T rank_end = 20 * (trace_sorted[0] - trace_sorted[nelems-1]);
-        const T rank_start = 0 ;
-        const T rank_step = (rank_end - rank_start)/ (rank_length-1);
-        //Generate values for rank
-        std::vector<T> rank(rank_length,0);
-        std::vector<T> probCCDF(rank_length,0);
-        std::vector<T> probCCDFlow(rank_length,0);
-        std::vector<T> probCCDFhigh(rank_length,0);
-        arange(rank,rank_start,rank_step);
-
-        //The most expensive step is this one. Especially if you use long double
-        setExponSurvivalFunction(probCCDF,rank, rate);
-        setExponSurvivalFunction(probCCDFlow,rank, ratelow);
-        setExponSurvivalFunction(probCCDFhigh,rank, ratehigh);
-        //Add mean to all the rank values.
-        //TODO!!! already create rank starting from the mean and keep it into
-        // account while generating the survival function.
-        for( auto &v : rank )  v += trace_sorted[nelems-1];
-
         //TODO estimate the real type of tail
         return neither::right(std::make_shared <EVTDistribution<T> > (distribution_type_e::EVT_EXPONENTIAL,
-                              tailValues, rank, probCCDF, probCCDFlow, probCCDFhigh));
+                              std::move(tailValues), trace_sorted[nelems-1], rate, ratelow, ratehigh,
+                              rank_length));
     }
 
 };
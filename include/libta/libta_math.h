@@ -26,7 +26,7 @@ namespace libta {
     *
     */
     template <typename T>
-    T getUnbiasedMean(std::vector<T> v, size_t start, size_t size) {
+    T getUnbiasedMean(const std::vector<T> &v, size_t start, size_t size) {
         assert(start+size <= v.size());
         assert(start+size-1 >= 0);
         T result=0;
@@ -41,7 +41,7 @@ namespace libta {
     *
     */
     template <typename T>
-    T getUnbiasedStdDeviation(std::vector<T> v, size_t start, size_t size) {
+    T getUnbiasedStdDeviation(const std::vector<T> &v, size_t start, size_t size) {
         assert(start+size <= v.size());
         assert(start+size-1 >= 0);
         T sumOfSquares=0;
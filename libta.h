@@ -23,12 +23,22 @@
 #ifndef LIBTA_H_
 #define LIBTA_H_
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <chrono>
 #include <cmath>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <iterator>
 #include <memory>
+#include <thread>
 #include <vector>
 #include <tuple>
 #include <exception>
+#include <stdexcept>
+#include <string>
 
 namespace libta {
 
@@ -44,7 +54,8 @@ namespace libta {
  */
 typedef enum class response_type_e {
     PWCET_DISTRIBUTION,    /*!< The output is a statistical distribution */
-    WCET_VALUE             /*!< The output is a single WCET value */
+    WCET_VALUE,            /*!< The output is a single WCET value */
+    PWCET_ENVELOPE         /*!< The output is the envelope of several distributions */
 } response_type_t;
 
 /**
@@ -65,7 +76,9 @@ typedef enum class distribution_type_e {
  */
 typedef enum class error_e {
     INVALID_DATA,
-    INVALID_DISTRIBUTION
+    INVALID_DISTRIBUTION,
+    CANCELLED,              /*!< The analysis has been cancelled by the caller */
+    DEADLINE_EXPIRED        /*!< The analysis did not complete before its deadline */
 } error_t;
 
 //
@@ -134,7 +147,7 @@ public:
       */
     ResponseEVTDistribution(distribution_type_t dist_type) noexcept
         : Response(response_type_t::PWCET_DISTRIBUTION),
-          dist_type(dist_type) {
+          dist_type(dist_type), used_samples(0), total_samples(0), complete(true) {
         
     }
     
@@ -189,13 +202,104 @@ public:
         return this->dist_type;
     }
 
+    /**
+     * @brief Setter for the portion of the trace the estimate is based on
+     * @param used      The number of samples used for the estimation
+     * @param total     The number of samples in the request
+     * @param complete  False if the estimate may change when using the remaining samples
+     */
+    void set_trace_usage(size_t used, size_t total, bool complete) noexcept {
+        assert(used <= total);
+        this->used_samples  = used;
+        this->total_samples = total;
+        this->complete      = complete;
+    }
+
+    /** @brief Getter for the number of samples used for the estimation */
+    inline size_t get_used_samples() const noexcept {
+        return this->used_samples;
+    }
+
+    /** @brief Getter for the number of samples in the request */
+    inline size_t get_total_samples() const noexcept {
+        return this->total_samples;
+    }
+
+    /** @brief False if the estimate is partial (e.g. an anytime analysis out of budget) */
+    inline bool is_complete() const noexcept {
+        return this->complete;
+    }
+
 	double get_quantile(double p) const {
-		switch(this->dist_type) {
+		return quantile(this->dist_type, this->params, p);
+	}
+
+	/** @brief Probability of exceeding the given value, i.e. P(X > x) */
+	double get_exceedance(double x) const noexcept {
+		double out;
+		exceedance(this->dist_type, this->params, &x, &out, 1);
+		return out;
+	}
+
+	/** @brief Probability of exceeding each of the n budgets, i.e. out[i] = P(X > budgets[i]) */
+	void get_exceedance(const double *budgets, double *out, size_t n) const noexcept {
+		exceedance(this->dist_type, this->params, budgets, out, n);
+	}
+
+	/**
+	 * @brief Exceedance probabilities of a distribution of the given type and parameters
+	 *
+	 * The closed-form survival functions are evaluated with log1p/expm1, so that the accuracy is
+	 * preserved for tiny exceedance probabilities. The dispatch on the distribution type and on
+	 * the shape parameter is done once per batch, leaving a branch-light loop.
+	 */
+	static void exceedance(distribution_type_t dist_type, const parameters_t &params,
+	                       const double *x, double *out, size_t n) noexcept {
+		const double mu = std::get<P_MU>(params);
+		const double inv_sg = 1. / std::get<P_SIGMA>(params);
+		const double xi = std::get<P_XI>(params);
+
+		if (dist_type == distribution_type_t::EVT_GEV) {
+			if (xi == 0.) {
+				for (size_t i = 0; i < n; i++) {
+					const double z = (x[i] - mu) * inv_sg;
+					out[i] = -std::expm1(-std::exp(-z));
+				}
+			} else {
+				const double inv_xi = 1. / xi;
+				const double outside = xi > 0. ? 1. : 0.;    // Below lower / above upper endpoint
+				for (size_t i = 0; i < n; i++) {
+					const double xz = xi * (x[i] - mu) * inv_sg;
+					out[i] = xz <= -1. ? outside
+					                   : -std::expm1(-std::exp(-inv_xi * std::log1p(xz)));
+				}
+			}
+			return;
+		}
+
+		if (xi == 0.) {
+			for (size_t i = 0; i < n; i++) {
+				const double z = (x[i] - mu) * inv_sg;
+				out[i] = std::min(std::exp(-z), 1.);
+			}
+		} else {
+			const double inv_xi = 1. / xi;
+			for (size_t i = 0; i < n; i++) {
+				const double xz = xi * (x[i] - mu) * inv_sg;
+				// Below the threshold or above the upper endpoint (xi < 0)
+				out[i] = x[i] <= mu ? 1. : (xz <= -1. ? 0. : std::exp(-inv_xi * std::log1p(xz)));
+			}
+		}
+	}
+
+	/** @brief Quantile of a distribution of the given type and parameters */
+	static double quantile(distribution_type_t dist_type, const parameters_t &params, double p) {
+		switch(dist_type) {
 			case distribution_type_t::EVT_GEV:
-				return get_gev_quantile(p);
+				return get_gev_quantile(params, p);
 			case distribution_type_t::EVT_GPD_2PARAM:
 			case distribution_type_t::EVT_GPD_3PARAM:
-				return get_gpd_quantile(p);
+				return get_gpd_quantile(params, p);
 			default:
 				assert(false);
 		}
@@ -206,8 +310,11 @@ public:
 private:
     const distribution_type_t dist_type;
     parameters_t params;
+    size_t used_samples;
+    size_t total_samples;
+    bool complete;
 
-	double get_gev_quantile(double p) const {
+	static double get_gev_quantile(const parameters_t &params, double p) {
 		if (p <= 0. || p >= 1.) {
 		    throw std::invalid_argument("The probability value is not valid.");
 		}
@@ -223,7 +330,7 @@ private:
 		}
 	}
 
-	double get_gpd_quantile(double p) const {
+	static double get_gpd_quantile(const parameters_t &params, double p) {
 		auto mu = std::get<P_MU>(params);
 		auto sg = std::get<P_SIGMA>(params);
 		auto xi = std::get<P_XI>(params);
@@ -285,9 +392,18 @@ private:
 
 };
 
+/**
+ * @brief The context of a sample, e.g. its input class, core or frequency level
+ */
+typedef uint16_t tag_t;
+
 /**
  * @brief The class representing the objects sent to the timing analysis tool 
  *
+ * Every execution time can carry a tag. The tags are stored in a separate array (structure of
+ * arrays), which stays empty until the first tagged value is added: untagged requests cost
+ * nothing more, and the analyzers keep reading a plain array of times. The values added without
+ * a tag to a tagged request get tag 0.
  */
 template <typename T>
 class Request {
@@ -299,6 +415,19 @@ public:
       */
     Request() noexcept {}
 
+    /** @brief Adopt an existing vector of execution times, without copying it */
+    explicit Request(std::vector<T> &&times) noexcept
+        : execution_times(std::move(times)), appended(execution_times.size()) {}
+
+    /** @brief Copy the execution times from an iterator range */
+    template <typename InputIt,
+              typename = typename std::iterator_traits<InputIt>::iterator_category>
+    Request(InputIt first, InputIt last)
+        : execution_times(first, last), appended(execution_times.size()) {}
+
+    /** @brief Copy the execution times from a contiguous array (a single memcpy) */
+    Request(const T *data, size_t size) : execution_times(data, data + size), appended(size) {}
+
     virtual ~Request() = default;
 
     /** @brief Begin iterator for for-range-loops */
@@ -329,11 +458,131 @@ public:
     /** @brief Add new values to the timing array */
     inline void add_value(const T& time) {
         this->execution_times.push_back(time);
+        if (! this->tags.empty()) {
+            this->tags.push_back(0);
+        }
+        this->appended++;
+    }
+
+    /** @brief Add a new tagged value to the timing array */
+    inline void add_value(const T& time, tag_t tag) {
+        this->tags.resize(this->execution_times.size(), 0);
+        this->execution_times.push_back(time);
+        this->tags.push_back(tag);
+        this->appended++;
+    }
+
+    /** @brief Append the values of an iterator range to the timing array */
+    template <typename InputIt,
+              typename = typename std::iterator_traits<InputIt>::iterator_category>
+    inline void add_values(InputIt first, InputIt last) {
+        const size_t size = this->execution_times.size();
+        this->execution_times.insert(this->execution_times.end(), first, last);
+        if (! this->tags.empty()) {
+            this->tags.resize(this->execution_times.size(), 0);
+        }
+        this->appended += this->execution_times.size() - size;
+    }
+
+    /** @brief Append the values of a contiguous array to the timing array */
+    inline void add_values(const T *data, size_t size) {
+        this->execution_times.insert(this->execution_times.end(), data, data + size);
+        if (! this->tags.empty()) {
+            this->tags.resize(this->execution_times.size(), 0);
+        }
+        this->appended += size;
+    }
+
+    /** @brief Append the values of a contiguous array and their tags */
+    inline void add_values(const T *data, const tag_t *tags, size_t size) {
+        this->tags.resize(this->execution_times.size(), 0);
+        this->execution_times.insert(this->execution_times.end(), data, data + size);
+        this->tags.insert(this->tags.end(), tags, tags + size);
+        this->appended += size;
+    }
+
+    /** @brief Replace the timing array with the given vector, without copying it. The request
+     *         becomes untagged and all the given values count as appended. */
+    inline void set_values(std::vector<T> &&times) noexcept {
+        this->execution_times = std::move(times);
+        this->tags.clear();
+        this->appended += this->execution_times.size();
+    }
+
+    /** @brief Replace the timing array and the tags with the given vectors, without copying them.
+     *         All the given values count as appended. */
+    inline void set_values(std::vector<T> &&times, std::vector<tag_t> &&tags) {
+        if (times.size() != tags.size()) {
+            throw std::invalid_argument("The number of tags differs from the number of values.");
+        }
+        this->execution_times = std::move(times);
+        this->tags = std::move(tags);
+        this->appended += this->execution_times.size();
+    }
+
+    /** @brief Remove the given number of oldest values (and their tags), e.g. to keep a window
+     *         of the most recent ones */
+    inline void discard_oldest(size_t count) noexcept {
+        count = std::min(count, this->execution_times.size());
+        this->execution_times.erase(this->execution_times.begin(),
+                                    this->execution_times.begin() + count);
+        if (! this->tags.empty()) {
+            this->tags.erase(this->tags.begin(), this->tags.begin() + count);
+        }
+    }
+
+    /**
+     * @brief Getter for the number of values appended over the lifetime of the request, by the
+     *        constructors, add_value(), add_values() and set_values()
+     *
+     * Clearing or trimming the request does not decrease it, so the values appended since a
+     * previous call are the last (difference) ones, if still in the request.
+     */
+    inline uint64_t get_appended() const noexcept {
+        return this->appended;
+    }
+
+    /** @brief Move the timing array out of the request, leaving the request empty */
+    inline std::vector<T> release_values() noexcept {
+        std::vector<T> times(std::move(this->execution_times));
+        this->execution_times.clear();
+        this->tags.clear();
+        return times;
+    }
+
+    /** @brief Getter for the tags, one per value, or an empty array if the request is untagged */
+    inline const std::vector<tag_t> &get_tags() const noexcept {
+        return this->tags;
+    }
+
+    /** @brief Whether any value has been added with a tag */
+    inline bool has_tags() const noexcept {
+        return ! this->tags.empty();
+    }
+
+    /** @brief Reserve memory for the given number of values */
+    inline void reserve(size_t capacity) {
+        this->execution_times.reserve(capacity);
+        if (! this->tags.empty()) {
+            this->tags.reserve(capacity);
+        }
+    }
+
+    /** @brief Getter for the number of values that fit without reallocation */
+    inline size_t capacity() const noexcept {
+        return this->execution_times.capacity();
+    }
+
+    /** @brief Getter for the number of values */
+    inline size_t size() const noexcept {
+        return this->execution_times.size();
     }
 
 private:
 
     std::vector<T> execution_times;
+    std::vector<tag_t> tags;
+    uint64_t appended = 0;      /*!< Values ever appended, see get_appended() */
 
 };
 
@@ -353,6 +602,194 @@ private:
 	error_t err;
 };
 
+/**
+ * @brief The value-typed result of an analysis
+ *
+ * It holds either a distribution (type and parameters_t), a WCET value or an error code, like a
+ * variant. Unlike the Response hierarchy, it is returned by value: no heap allocation, atomic
+ * reference counting or RTTI is involved in producing or inspecting it.
+ */
+template <typename T>
+class AnalysisResult {
+
+public:
+
+    typedef ResponseEVTDistribution::parameters_t parameters_t;
+
+    /** @brief The kind of value actually stored */
+    typedef enum class kind_e {
+        DISTRIBUTION,
+        WCET,
+        ERROR
+    } kind_t;
+
+    /** @brief Build a result holding a distribution */
+    static AnalysisResult distribution(distribution_type_t dist_type, const parameters_t &params) noexcept {
+        AnalysisResult r(kind_t::DISTRIBUTION);
+        r.dist_type = dist_type;
+        r.params = params;
+        return r;
+    }
+
+    /** @brief Build a result holding the same distribution of a ResponseEVTDistribution */
+    static AnalysisResult distribution(const ResponseEVTDistribution &resp) noexcept {
+        return distribution(resp.get_dist_type(), resp.get_parameters());
+    }
+
+    /** @brief Build a result holding a WCET value */
+    static AnalysisResult wcet(T value) noexcept {
+        AnalysisResult r(kind_t::WCET);
+        r.wcet_value = value;
+        return r;
+    }
+
+    /** @brief Build a result holding an error */
+    static AnalysisResult error(error_t err) noexcept {
+        AnalysisResult r(kind_t::ERROR);
+        r.err = err;
+        return r;
+    }
+
+    /** @brief Getter for the kind of value stored */
+    inline kind_t get_kind() const noexcept {
+        return this->kind;
+    }
+
+    inline bool is_distribution() const noexcept {
+        return this->kind == kind_t::DISTRIBUTION;
+    }
+
+    inline bool is_wcet() const noexcept {
+        return this->kind == kind_t::WCET;
+    }
+
+    inline bool is_error() const noexcept {
+        return this->kind == kind_t::ERROR;
+    }
+
+    /** @brief Getter for the distribution type. Valid only if is_distribution() */
+    inline distribution_type_t get_dist_type() const noexcept {
+        assert(is_distribution());
+        return this->dist_type;
+    }
+
+    /** @brief Getter for the distribution parameters. Valid only if is_distribution() */
+    inline const parameters_t &get_parameters() const noexcept {
+        assert(is_distribution());
+        return this->params;
+    }
+
+    /** @brief Quantile of the distribution. Valid only if is_distribution() */
+    inline double get_quantile(double p) const {
+        assert(is_distribution());
+        return ResponseEVTDistribution::quantile(this->dist_type, this->params, p);
+    }
+
+    /** @brief Getter for the WCET value. Valid only if is_wcet() */
+    inline T get_wcet_value() const noexcept {
+        assert(is_wcet());
+        return this->wcet_value;
+    }
+
+    /** @brief Getter for the error code. Valid only if is_error() */
+    inline error_t get_error() const noexcept {
+        assert(is_error());
+        return this->err;
+    }
+
+private:
+    kind_t kind;
+    distribution_type_t dist_type;
+    parameters_t params;
+    T wcet_value;
+    error_t err;
+
+    explicit AnalysisResult(kind_t kind) noexcept
+        : kind(kind), dist_type(distribution_type_t::EVT_GPD_2PARAM), params(0, 0, 0, 0),
+          wcet_value(), err(error_t::INVALID_DATA) {}
+};
+
+/**
+ * @brief A token used to cancel one or more pending analyses
+ *
+ * Copies of the token share the same state, so the caller keeps one copy and passes the other
+ * one to the analysis.
+ */
+class CancellationToken {
+
+public:
+
+    CancellationToken() : cancelled(std::make_shared<std::atomic<bool>>(false)) {}
+
+    /** @brief A token that can never be cancelled. It does not allocate. */
+    static CancellationToken none() noexcept {
+        return CancellationToken(nullptr);
+    }
+
+    /** @brief Request the cancellation of all the analyses using this token */
+    inline void cancel() noexcept {
+        assert(this->cancelled);
+        this->cancelled->store(true, std::memory_order_relaxed);
+    }
+
+    /** @brief Check if the cancellation has been requested */
+    inline bool is_cancelled() const noexcept {
+        return this->cancelled && this->cancelled->load(std::memory_order_relaxed);
+    }
+
+private:
+    std::shared_ptr<std::atomic<bool>> cancelled;
+
+    explicit CancellationToken(std::nullptr_t) noexcept {}
+};
+
+/**
+ * @brief The execution constraints of an analysis: a cancellation token and a deadline
+ *
+ * Analyzers call check() between their phases, so a cancelled or late analysis is abandoned
+ * at the next phase boundary by throwing a TimingAnalyzerError.
+ */
+class AnalysisControl {
+
+public:
+
+    typedef std::chrono::steady_clock clock_t;
+
+    /** @brief No cancellation and no deadline */
+    AnalysisControl() noexcept : token(CancellationToken::none()),
+                                 deadline(clock_t::time_point::max()) {}
+
+    AnalysisControl(CancellationToken token, clock_t::time_point deadline = clock_t::time_point::max())
+        noexcept : token(std::move(token)), deadline(deadline) {}
+
+    AnalysisControl(CancellationToken token, clock_t::duration timeout)
+        : token(std::move(token)), deadline(clock_t::now() + timeout) {}
+
+    /** @brief Getter for the cancellation token */
+    inline const CancellationToken &get_token() const noexcept {
+        return this->token;
+    }
+
+    /** @brief Getter for the deadline */
+    inline clock_t::time_point get_deadline() const noexcept {
+        return this->deadline;
+    }
+
+    /** @brief Throw a TimingAnalyzerError if the analysis has to be abandoned */
+    inline void check() const {
+        if(this->token.is_cancelled()) {
+            throw TimingAnalyzerError("The analysis has been cancelled.", error_t::CANCELLED);
+        }
+        if(this->deadline != clock_t::time_point::max() && clock_t::now() > this->deadline) {
+            throw TimingAnalyzerError("The analysis deadline expired.", error_t::DEADLINE_EXPIRED);
+        }
+    }
+
+private:
+    CancellationToken token;
+    clock_t::time_point deadline;
+};
+
 /**
  * @brief The main class to be inherited and implemented by the Timing Analysis tool.
  *
@@ -363,6 +800,10 @@ class TimingAnalyzer {
 
 public:
 
+    /** @brief The completion callback of the asynchronous analysis. On failure the response is
+     *         nullptr and the exception pointer is set. */
+    typedef std::function<void(std::shared_ptr<Response>, std::exception_ptr)> completion_t;
+
 	virtual ~TimingAnalyzer() = default;
 
     /**
@@ -370,6 +811,80 @@ public:
      */
     virtual std::shared_ptr<Response> perform_analysis(std::shared_ptr<Request<T>> req) = 0;
 
+    /**
+     * @brief Perform the analysis and return the result by value.
+     *
+     * Analysis errors are returned as AnalysisResult::error() instead of being thrown. The
+     * default implementation wraps perform_analysis(): implementations should override it to
+     * avoid the heap allocation of the Response.
+     */
+    virtual AnalysisResult<T> analyze(const Request<T> &req) {
+        // Non-owning pointer: the request is not copied
+        std::shared_ptr<Request<T>> req_ptr(std::shared_ptr<Request<T>>(),
+                                            const_cast<Request<T>*>(&req));
+        std::shared_ptr<Response> resp;
+        try {
+            resp = this->perform_analysis(req_ptr);
+        } catch(const TimingAnalyzerError &e) {
+            return AnalysisResult<T>::error(e.get_type());
+        }
+
+        switch(resp->get_response_type()) {
+            case response_type_t::PWCET_DISTRIBUTION:
+                return AnalysisResult<T>::distribution(
+                                    static_cast<const ResponseEVTDistribution&>(*resp));
+            case response_type_t::WCET_VALUE:
+                return AnalysisResult<T>::wcet(
+                                    static_cast<const ResponseWCET<T>&>(*resp).get_wcet_value());
+            default:
+                return AnalysisResult<T>::error(error_t::INVALID_DISTRIBUTION);
+        }
+    }
+
+    /**
+     * @brief Perform the analysis under the given cancellation token and deadline.
+     *
+     * The default implementation only checks the constraints before starting the analysis.
+     * Implementations should override it and call AnalysisControl::check() between phases.
+     */
+    virtual std::shared_ptr<Response> perform_analysis(std::shared_ptr<Request<T>> req,
+                                                       const AnalysisControl &control) {
+        control.check();
+        return this->perform_analysis(req);
+    }
+
+    /**
+     * @brief Run the analysis in a separate thread.
+     *
+     * Errors (including cancellation and deadline expiration) are reported through the future as
+     * TimingAnalyzerError. The analyzer must outlive the analysis.
+     */
+    std::future<std::shared_ptr<Response>> perform_analysis_async(std::shared_ptr<Request<T>> req,
+                                                    AnalysisControl control = AnalysisControl()) {
+        return std::async(std::launch::async, [this, req, control]() {
+            return this->perform_analysis(req, control);
+        });
+    }
+
+    /**
+     * @brief Run the analysis in a separate detached thread and call `done` on completion.
+     *
+     * The callback is invoked from the analysis thread. The analyzer must outlive the analysis.
+     */
+    void perform_analysis_async(std::shared_ptr<Request<T>> req, AnalysisControl control,
+                                completion_t done) {
+        std::thread([this, req, control, done]() {
+            std::shared_ptr<Response> result;
+            try {
+                result = this->perform_analysis(req, control);
+            } catch(...) {
+                done(nullptr, std::current_exception());
+                return;
+            }
+            done(std::move(result), nullptr);
+        }).detach();
+    }
+
 };
 
 }    // libta
@@ -0,0 +1,149 @@
+/** @file libta_c.h
+ * The C interface of libta.
+ *
+ * A stable C ABI to embed the analysis in C runtimes. The samples are read directly from the
+ * caller arrays, the results are written into a caller-provided structure and the errors are
+ * reported as status codes: no C++ type and no exception crosses the interface.
+ *
+ * Analyzers and workspaces are opaque handles. A workspace holds all the memory of an analysis:
+ * when it is created large enough for the traces to be analyzed, the analysis functions perform
+ * no heap allocation. A workspace must not be used by two analyses at the same time, while an
+ * analyzer can be shared by any number of threads, each with its own workspace.
+ *
+ * @copyright
+ * Copyright 2020 Politecnico di Milano
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef LIBTA_C_H_
+#define LIBTA_C_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** @brief The version of the C interface, incremented at every incompatible change */
+#define LIBTA_C_API_VERSION 1
+
+/**
+ * @brief The status codes
+ */
+typedef enum libta_status_e {
+    LIBTA_OK = 0,                       /*!< Success */
+    LIBTA_E_INVALID_ARGUMENT,           /*!< Null pointer, mismatching types, invalid value */
+    LIBTA_E_INVALID_DATA,               /*!< The samples do not allow the analysis */
+    LIBTA_E_INVALID_DISTRIBUTION,       /*!< The estimated distribution is not valid */
+    LIBTA_E_CANCELLED,                  /*!< The analysis has been cancelled */
+    LIBTA_E_DEADLINE_EXPIRED,           /*!< The analysis deadline expired */
+    LIBTA_E_NO_MEMORY,                  /*!< Memory allocation failed */
+    LIBTA_E_INTERNAL                    /*!< Unexpected internal error */
+} libta_status_t;
+
+/**
+ * @brief The type of the samples
+ */
+typedef enum libta_sample_type_e {
+    LIBTA_SAMPLES_U64,                  /*!< uint64_t samples, e.g. cycles or nanoseconds */
+    LIBTA_SAMPLES_DOUBLE                /*!< double samples */
+} libta_sample_type_t;
+
+/**
+ * @brief The distribution types, with the same values of libta::distribution_type_t
+ */
+typedef enum libta_dist_type_e {
+    LIBTA_EVT_GEV = 0,
+    LIBTA_EVT_GPD_2PARAM,
+    LIBTA_EVT_GPD_3PARAM
+} libta_dist_type_t;
+
+/**
+ * @brief The parameters of an EVT distribution
+ */
+typedef struct libta_params_s {
+    double mu;
+    double sigma;
+    double xi;
+    double threshold;
+} libta_params_t;
+
+/**
+ * @brief The result of an analysis
+ */
+typedef struct libta_result_s {
+    libta_dist_type_t dist_type;
+    libta_params_t params;              /*!< The estimated distribution */
+    libta_params_t low;                 /*!< Lower bound of the confidence interval */
+    libta_params_t high;                /*!< Upper bound of the confidence interval */
+    uint64_t samples;                   /*!< Number of samples analyzed */
+    uint64_t tail_samples;              /*!< Number of samples used to fit the tail */
+} libta_result_t;
+
+typedef struct libta_analyzer_s libta_analyzer_t;
+typedef struct libta_workspace_s libta_workspace_t;
+
+/**
+ * @brief Create an analyzer
+ * @param sample_type  The type of the samples that will be analyzed
+ * @param rank_length  The resolution of the survival function (0 for the default)
+ * @param analyzer     Set to the new analyzer
+ */
+libta_status_t libta_analyzer_create(libta_sample_type_t sample_type, int rank_length,
+                                     libta_analyzer_t **analyzer);
+
+/** @brief Destroy an analyzer. NULL is ignored. */
+void libta_analyzer_destroy(libta_analyzer_t *analyzer);
+
+/**
+ * @brief Create a workspace for the given analyzer
+ * @param max_samples  The memory for traces up to max_samples samples is allocated immediately
+ * @param workspace    Set to the new workspace
+ */
+libta_status_t libta_workspace_create(const libta_analyzer_t *analyzer, size_t max_samples,
+                                      libta_workspace_t **workspace);
+
+/** @brief Destroy a workspace. NULL is ignored. */
+void libta_workspace_destroy(libta_workspace_t *workspace);
+
+/**
+ * @brief Analyze an array of uint64_t samples. The analyzer must be of type LIBTA_SAMPLES_U64.
+ *
+ * The analysis is performed in double precision, so samples above 2^53 are rounded.
+ */
+libta_status_t libta_analyze_u64(const libta_analyzer_t *analyzer, libta_workspace_t *workspace,
+                                 const uint64_t *samples, size_t size, libta_result_t *result);
+
+/**
+ * @brief Analyze an array of double samples. The analyzer must be of type LIBTA_SAMPLES_DOUBLE.
+ */
+libta_status_t libta_analyze_double(const libta_analyzer_t *analyzer, libta_workspace_t *workspace,
+                                    const double *samples, size_t size, libta_result_t *result);
+
+/**
+ * @brief The value exceeded with probability 1-p by the distribution in params
+ * @param p  The probability of NOT exceeding the value, in (0, 1)
+ */
+libta_status_t libta_quantile(libta_dist_type_t dist_type, const libta_params_t *params, double p,
+                              double *value);
+
+/** @brief A static human-readable description of a status code */
+const char *libta_status_string(libta_status_t status);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LIBTA_C_H_
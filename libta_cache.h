@@ -0,0 +1,346 @@
+/** @file libta_cache.h
+ * Serialization of the analysis results and on-disk result cache.
+ *
+ * A ResponseEVTDistribution (plus the optional low/high bounds produced by some analyzers) is
+ * serialized into a small, fixed-layout and versioned binary record. The ResultCache stores such
+ * records on disk, keyed by a fast hash of the Request contents and of the analyzer
+ * configuration, so that unchanged traces can be restored without running the analysis again.
+ *
+ * @copyright
+ * Copyright 2020 Politecnico di Milano
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef LIBTA_CACHE_H_
+#define LIBTA_CACHE_H_
+
+#include "libta.h"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <type_traits>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace libta {
+
+//
+// ------------------------------------- HASHING -------------------------------------
+//
+
+/**
+ * @brief Mix a 64-bit word into the hash state (murmur3 finalizer based)
+ */
+inline uint64_t hash_mix(uint64_t h, uint64_t word) noexcept {
+    word *= 0xff51afd7ed558ccdULL;
+    word ^= word >> 33;
+    word *= 0xc4ceb9fe1a85ec53ULL;
+    word ^= word >> 33;
+    h ^= word;
+    h = (h << 27) | (h >> 37);
+    return h * 5 + 0x52dce729ULL;
+}
+
+/**
+ * @brief Fast non-cryptographic 64-bit hash of a memory area. The data is consumed 8 bytes at
+ *        a time, so the cost is dominated by the memory bandwidth.
+ */
+inline uint64_t hash_bytes(const void *data, size_t size, uint64_t seed = 0) noexcept {
+    const unsigned char *ptr = static_cast<const unsigned char*>(data);
+    uint64_t h = seed ^ (size * 0x9e3779b97f4a7c15ULL);
+
+    size_t i = 0;
+    for(; i + 8 <= size; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, ptr + i, 8);
+        h = hash_mix(h, word);
+    }
+
+    if(i < size) {
+        uint64_t word = 0;
+        std::memcpy(&word, ptr + i, size - i);
+        h = hash_mix(h, word);
+    }
+
+    return hash_mix(h, size);
+}
+
+/**
+ * @brief Hash of the execution times contained in a request
+ * @param config  The hash of the analyzer configuration, mixed into the result
+ */
+template <typename T>
+inline uint64_t hash_request(const Request<T> &req, uint64_t config = 0) noexcept {
+    static_assert(std::is_arithmetic<T>::value, "Only arithmetic types can be hashed");
+    const auto &values = req.get_all();
+
+    uint64_t h = hash_mix(config, sizeof(T));
+    if(std::is_same<T, long double>::value) {
+        // The x87 extended format has padding bytes with undefined content, so hash the
+        // mantissa and the exponent instead of the raw object representation
+        for(const auto &v : values) {
+            int exp;
+            const long double mant = std::frexp(static_cast<long double>(v), &exp);
+            h = hash_mix(h, static_cast<uint64_t>(static_cast<int64_t>(std::ldexp(mant, 63))));
+            h = hash_mix(h, static_cast<uint64_t>(exp));
+        }
+        return hash_mix(h, values.size());
+    }
+
+    return hash_bytes(values.data(), values.size() * sizeof(T), h);
+}
+
+//
+// ---------------------------------- SERIALIZATION ----------------------------------
+//
+
+/**
+ * @brief The content of a serialized analysis result
+ *
+ * The low and high bounds are the distributions estimated at the boundaries of the confidence
+ * interval (see for example BSCTimingAnalyzer::get_low_gpd()). They are optional.
+ */
+struct EVTRecord {
+    distribution_type_t dist_type = distribution_type_t::EVT_GPD_2PARAM;
+    ResponseEVTDistribution::parameters_t params;
+    bool has_bounds = false;
+    ResponseEVTDistribution::parameters_t low;
+    ResponseEVTDistribution::parameters_t high;
+};
+
+/**
+ * @brief The serialization format
+ *
+ * | offset | size | content                                   |
+ * |--------|------|-------------------------------------------|
+ * | 0      | 4    | magic "LTAR"                              |
+ * | 4      | 1    | format version                            |
+ * | 5      | 1    | distribution type                         |
+ * | 6      | 1    | flags (bit 0: low/high bounds present)    |
+ * | 7      | 1    | reserved (zero)                           |
+ * | 8      | 32   | mu, sigma, xi, threshold                  |
+ * | 40     | 64   | low and high bounds parameters (optional) |
+ *
+ * All the doubles are stored as IEEE-754 little-endian.
+ */
+namespace serial {
+    static constexpr uint8_t  VERSION     = 1;
+    static constexpr size_t   HEADER_SIZE = 8;
+    static constexpr size_t   PARAMS_SIZE = 4 * sizeof(uint64_t);
+    static constexpr size_t   MAX_SIZE    = HEADER_SIZE + 3 * PARAMS_SIZE;
+    static constexpr uint8_t  FLAG_BOUNDS = 0x01;
+
+    inline void put_u64(uint8_t *buf, uint64_t v) noexcept {
+        for(int i=0; i<8; i++) {
+            buf[i] = static_cast<uint8_t>(v >> (8*i));
+        }
+    }
+
+    inline uint64_t get_u64(const uint8_t *buf) noexcept {
+        uint64_t v = 0;
+        for(int i=0; i<8; i++) {
+            v |= static_cast<uint64_t>(buf[i]) << (8*i);
+        }
+        return v;
+    }
+
+    inline void put_double(uint8_t *buf, double v) noexcept {
+        static_assert(sizeof(double) == sizeof(uint64_t), "Unsupported double format");
+        uint64_t bits;
+        std::memcpy(&bits, &v, sizeof(bits));
+        put_u64(buf, bits);
+    }
+
+    inline double get_double(const uint8_t *buf) noexcept {
+        const uint64_t bits = get_u64(buf);
+        double v;
+        std::memcpy(&v, &bits, sizeof(v));
+        return v;
+    }
+
+    inline void put_params(uint8_t *buf, const ResponseEVTDistribution::parameters_t &p) noexcept {
+        put_double(buf,      std::get<ResponseEVTDistribution::P_MU>(p));
+        put_double(buf + 8,  std::get<ResponseEVTDistribution::P_SIGMA>(p));
+        put_double(buf + 16, std::get<ResponseEVTDistribution::P_XI>(p));
+        put_double(buf + 24, std::get<ResponseEVTDistribution::P_THRSH>(p));
+    }
+
+    inline ResponseEVTDistribution::parameters_t get_params(const uint8_t *buf) noexcept {
+        return std::make_tuple(get_double(buf), get_double(buf + 8),
+                               get_double(buf + 16), get_double(buf + 24));
+    }
+}   // namespace serial
+
+/**
+ * @brief Serialize a record into buf, which must be at least serial::MAX_SIZE bytes long.
+ * @return The number of bytes written
+ */
+inline size_t serialize(const EVTRecord &record, uint8_t *buf) noexcept {
+    buf[0] = 'L'; buf[1] = 'T'; buf[2] = 'A'; buf[3] = 'R';
+    buf[4] = serial::VERSION;
+    buf[5] = static_cast<uint8_t>(record.dist_type);
+    buf[6] = record.has_bounds ? serial::FLAG_BOUNDS : 0;
+    buf[7] = 0;
+
+    size_t size = serial::HEADER_SIZE;
+    serial::put_params(buf + size, record.params);
+    size += serial::PARAMS_SIZE;
+
+    if(record.has_bounds) {
+        serial::put_params(buf + size, record.low);
+        size += serial::PARAMS_SIZE;
+        serial::put_params(buf + size, record.high);
+        size += serial::PARAMS_SIZE;
+    }
+
+    return size;
+}
+
+/**
+ * @brief Deserialize a record previously produced by serialize()
+ * @return false if the buffer is truncated, corrupted or produced by an unknown format version
+ */
+inline bool deserialize(const uint8_t *buf, size_t size, EVTRecord &record) noexcept {
+    if(size < serial::HEADER_SIZE + serial::PARAMS_SIZE) {
+        return false;
+    }
+    if(buf[0] != 'L' || buf[1] != 'T' || buf[2] != 'A' || buf[3] != 'R'
+       || buf[4] != serial::VERSION) {
+        return false;
+    }
+    if(buf[5] > static_cast<uint8_t>(distribution_type_t::EVT_GPD_3PARAM)) {
+        return false;
+    }
+
+    record.dist_type  = static_cast<distribution_type_t>(buf[5]);
+    record.has_bounds = (buf[6] & serial::FLAG_BOUNDS) != 0;
+    record.params     = serial::get_params(buf + serial::HEADER_SIZE);
+
+    if(record.has_bounds) {
+        if(size < serial::MAX_SIZE) {
+            return false;
+        }
+        record.low  = serial::get_params(buf + serial::HEADER_SIZE + serial::PARAMS_SIZE);
+        record.high = serial::get_params(buf + serial::HEADER_SIZE + 2 * serial::PARAMS_SIZE);
+    }
+
+    return true;
+}
+
+//
+// ------------------------------------- CACHE -------------------------------------
+//
+
+/**
+ * @brief A directory-based persistent cache of analysis results
+ *
+ * Every entry is a file named after the 64-bit key containing a single serialized EVTRecord.
+ * Entries are written to a temporary file unique to the writer and then renamed, so that
+ * concurrent readers and writers (also from other processes) never observe a partially written
+ * entry. Corrupted or incompatible
+ * entries are simply reported as misses.
+ */
+class ResultCache {
+
+public:
+
+    /**
+     * @brief The ResultCache class constructor
+     * @param directory  An existing directory where the entries are stored
+     */
+    explicit ResultCache(std::string directory) : directory(std::move(directory)) {
+
+    }
+
+    virtual ~ResultCache() = default;
+
+    /** @brief Look-up an entry. Returns false on miss. */
+    bool load(uint64_t key, EVTRecord &record) const {
+        std::ifstream in(entry_path(key), std::ios::binary);
+        if(! in) {
+            return false;
+        }
+
+        uint8_t buf[serial::MAX_SIZE];
+        in.read(reinterpret_cast<char*>(buf), sizeof(buf));
+        return deserialize(buf, static_cast<size_t>(in.gcount()), record);
+    }
+
+    /** @brief Store an entry, replacing any previous entry with the same key */
+    bool store(uint64_t key, const EVTRecord &record) const {
+        uint8_t buf[serial::MAX_SIZE];
+        const size_t size = serialize(record, buf);
+
+        // Every writer has its own temporary file, so concurrent writers of the same key never
+        // write into the same file: the last rename wins, with a complete entry
+        const std::string path = entry_path(key);
+        std::string tmp_path = path + ".XXXXXX";
+        const int fd = mkstemp(&tmp_path[0]);
+        if(fd < 0) {
+            return false;
+        }
+        bool written = fchmod(fd, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH) == 0
+                    && write_all(fd, buf, size);
+        written = close(fd) == 0 && written;
+        if(! written || std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+            unlink(tmp_path.c_str());
+            return false;
+        }
+        return true;
+    }
+
+    /** @brief Remove an entry */
+    void invalidate(uint64_t key) const {
+        std::remove(entry_path(key).c_str());
+    }
+
+    /** @brief Getter for the cache directory */
+    inline const std::string &get_directory() const noexcept {
+        return this->directory;
+    }
+
+private:
+    const std::string directory;
+
+    static bool write_all(int fd, const uint8_t *buf, size_t size) noexcept {
+        while(size > 0) {
+            const ssize_t n = write(fd, buf, size);
+            if(n < 0 && errno == EINTR) {
+                continue;
+            }
+            if(n <= 0) {
+                return false;
+            }
+            buf += n;
+            size -= static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    std::string entry_path(uint64_t key) const {
+        char name[32];
+        std::snprintf(name, sizeof(name), "/%016llx.evt", static_cast<unsigned long long>(key));
+        return this->directory + name;
+    }
+};
+
+}    // libta
+
+#endif // LIBTA_CACHE_H_
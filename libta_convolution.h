@@ -0,0 +1,479 @@
+/** @file libta_convolution.h
+ * Discretization and convolution of pWCET distributions.
+ *
+ * The pWCET of a chain of tasks executed one after the other is the distribution of the sum of
+ * their execution times. Assuming independence, it is the convolution of the per-task
+ * distributions, which is much less pessimistic than the sum of the per-task quantiles.
+ * The distributions are discretized on a common grid and convolved with an FFT. The round-off
+ * of the FFT is bounded and added to the result, and the tail is recomputed with exponentially
+ * tilted FFTs, so the result is an upper bound which stays tight down to tiny probabilities.
+ *
+ * @copyright
+ * Copyright 2020 Politecnico di Milano
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef LIBTA_CONVOLUTION_H_
+#define LIBTA_CONVOLUTION_H_
+
+#include "libta.h"
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <limits>
+#include <vector>
+
+namespace libta {
+
+namespace convolution {
+
+    /** @brief Below this number of bins of the smallest operand the direct O(m*n) convolution
+     *         is faster than the FFT */
+    static constexpr size_t DIRECT_THRESHOLD = 64;
+
+    /** @brief Maximum relative error bound of an output bin considered accurate (see convolve()) */
+    static constexpr double RELATIVE_TOLERANCE = 1e-6;
+
+    /** @brief Probability mass below which a bin is not refined by a further tilt: its value
+     *         stays an upper bound, but with a large relative error (see convolve()) */
+    static constexpr double NEGLIGIBLE_MASS = 1e-30;
+
+    /** @brief Maximum number of exponentially tilted FFT convolutions (see convolve()) */
+    static constexpr int MAX_TILTS = 16;
+
+    /**
+     * @brief In-place iterative radix-2 FFT. The size of data must be a power of 2.
+     *
+     * The twiddle factors are computed directly instead of by repeated multiplication, so the
+     * error is O(log n) ulps of the norm of the data.
+     */
+    inline void fft(std::vector<std::complex<double>> &data, bool inverse) {
+        const size_t n = data.size();
+
+        // Bit-reversal permutation
+        for (size_t i = 1, j = 0; i < n; i++) {
+            size_t bit = n >> 1;
+            for (; j & bit; bit >>= 1) {
+                j ^= bit;
+            }
+            j ^= bit;
+            if (i < j) {
+                std::swap(data[i], data[j]);
+            }
+        }
+
+        std::vector<std::complex<double>> roots(n / 2);
+        for (size_t j = 0; j < n / 2; j++) {
+            roots[j] = std::polar(1., 2 * M_PI * j / n * (inverse ? 1 : -1));
+        }
+
+        for (size_t len = 2; len <= n; len <<= 1) {
+            const size_t stride = n / len;
+            for (size_t i = 0; i < n; i += len) {
+                for (size_t j = 0; j < len / 2; j++) {
+                    const std::complex<double> u = data[i + j];
+                    const std::complex<double> v = data[i + j + len / 2] * roots[j * stride];
+                    data[i + j]           = u + v;
+                    data[i + j + len / 2] = u - v;
+                }
+            }
+        }
+
+        if (inverse) {
+            for (auto &v : data) {
+                v /= static_cast<double>(n);
+            }
+        }
+    }
+
+    /**
+     * @brief Linear convolution of two real sequences with an FFT
+     *
+     * @param error  Set to a bound of the absolute error of every output element
+     */
+    inline std::vector<double> fft_convolve(const std::vector<double> &a, const std::vector<double> &b,
+                                            double &error) {
+        const size_t out_size = a.size() + b.size() - 1;
+        size_t n = 1;
+        int log2n = 0;
+        while (n < out_size) {
+            n <<= 1;
+            log2n++;
+        }
+
+        // Both real sequences are transformed at once as real and imaginary part
+        std::vector<std::complex<double>> data(n);
+        double a1 = 0., a2 = 0., b1 = 0., b2 = 0.;
+        for (size_t i = 0; i < a.size(); i++) {
+            data[i].real(a[i]);
+            a1 += std::abs(a[i]);
+            a2 += a[i] * a[i];
+        }
+        for (size_t i = 0; i < b.size(); i++) {
+            data[i].imag(b[i]);
+            b1 += std::abs(b[i]);
+            b2 += b[i] * b[i];
+        }
+        fft(data, false);
+
+        std::vector<std::complex<double>> prod(n);
+        for (size_t k = 0; k < n; k++) {
+            const std::complex<double> c  = data[k];
+            const std::complex<double> cc = std::conj(data[(n - k) & (n - 1)]);
+            const std::complex<double> fa = (c + cc) * 0.5;
+            const std::complex<double> fb = (c - cc) * std::complex<double>(0., -0.5);
+            prod[k] = fa * fb;
+        }
+        fft(prod, true);
+
+        // Each transform has a relative error (in 2-norm) of about 8 log2(n) ulps. Since a and b
+        // are transformed together, the error of either one is relative to the norm of both.
+        const double eps = std::numeric_limits<double>::epsilon();
+        error = 4 * (16 * log2n + 1) * eps * (std::sqrt(a2) + std::sqrt(b2)) * (a1 + b1);
+
+        std::vector<double> out(out_size);
+        for (size_t i = 0; i < out_size; i++) {
+            out[i] = prod[i].real();
+        }
+        return out;
+    }
+
+    /**
+     * @brief Linear convolution of two non-negative sequences, rounded up: every output element
+     *        is an upper bound of the exact one.
+     *
+     * The absolute error of an FFT convolution is about one ulp of the largest output element,
+     * which would be as large as the probabilities in the tail of a distribution. The sequences
+     * are therefore also convolved after an exponential tilt, a_i θ^i and b_j θ^j, whose
+     * result is θ^k times the exact one: with θ > 1 the error is relatively small in the bins
+     * around the peak of the tilted result. Tilts are added until every bin of the right tail
+     * has a relative error bound below RELATIVE_TOLERANCE, or a negligible mass (at most
+     * MAX_TILTS). Every bin takes the value of the tilt with the smallest error bound, and the
+     * bound is added to it.
+     */
+    inline std::vector<double> convolve(const std::vector<double> &a, const std::vector<double> &b) {
+        const size_t out_size = a.size() + b.size() - 1;
+        const double eps = std::numeric_limits<double>::epsilon();
+
+        if (std::min(a.size(), b.size()) <= DIRECT_THRESHOLD) {
+            std::vector<double> out(out_size, 0.);
+            for (size_t i = 0; i < a.size(); i++) {
+                for (size_t j = 0; j < b.size(); j++) {
+                    out[i + j] += a[i] * b[j];
+                }
+            }
+            // The sums of non-negative terms have a relative error below (terms + 1) ulps
+            const double round_up = 1 + 2 * (std::min(a.size(), b.size()) + 1) * eps;
+            for (auto &v : out) {
+                v *= round_up;
+            }
+            return out;
+        }
+
+        // The tilts are applied in the log domain, where zero is -infinity
+        std::vector<double> log_a(a.size()), log_b(b.size());
+        for (size_t i = 0; i < a.size(); i++) {
+            log_a[i] = std::log(std::max(a[i], 0.));
+        }
+        for (size_t i = 0; i < b.size(); i++) {
+            log_b[i] = std::log(std::max(b[i], 0.));
+        }
+
+        // Tilt a sequence by exp(t i), normalized so that its maximum is 1. Returns the log of the
+        // normalization factor.
+        const auto tilt = [](const std::vector<double> &log_x, double t, std::vector<double> &x) {
+            double shift = -std::numeric_limits<double>::infinity();
+            for (size_t i = 0; i < log_x.size(); i++) {
+                shift = std::max(shift, log_x[i] + t * i);
+            }
+            x.resize(log_x.size());
+            for (size_t i = 0; i < log_x.size(); i++) {
+                x[i] = std::exp(log_x[i] + t * i - shift);
+            }
+            return shift;
+        };
+
+        // Mean index of the tilted result, i.e. the sum of the mean indexes of the tilted operands
+        const auto tilted_mean = [](const std::vector<double> &log_x, double t) {
+            double shift = -std::numeric_limits<double>::infinity();
+            for (size_t i = 0; i < log_x.size(); i++) {
+                shift = std::max(shift, log_x[i] + t * i);
+            }
+            double sum = 0., weighted = 0.;
+            for (size_t i = 0; i < log_x.size(); i++) {
+                const double w = std::exp(log_x[i] + t * i - shift);
+                sum += w;
+                weighted += w * i;
+            }
+            return weighted / sum;
+        };
+
+        std::vector<double> value(out_size, 0.);
+        std::vector<double> bound(out_size, std::numeric_limits<double>::infinity());
+        std::vector<double> ta, tb;
+
+        // Only the right tail needs the tilts: the left one does not affect the survival function
+        double t = 0.;
+        size_t target = 0;
+        for (int round = 0; round < MAX_TILTS; round++) {
+            const double shift = tilt(log_a, t, ta) + tilt(log_b, t, tb);
+            if (! std::isfinite(shift)) {
+                break;
+            }
+            double error;
+            const std::vector<double> tilted = fft_convolve(ta, tb, error);
+            for (size_t k = 0; k < out_size; k++) {
+                const double scale = std::exp(shift - t * k);
+                if (error * scale < bound[k]) {
+                    value[k] = std::max(tilted[k], 0.) * scale;
+                    bound[k] = error * scale;
+                }
+            }
+
+            // The next target is the first bin of the right tail whose error bound is still
+            // relatively large
+            if (round == 0) {
+                target = std::max_element(value.cbegin(), value.cend()) - value.cbegin();
+            } else {
+                target++;
+            }
+            while (target < out_size
+                   && bound[target] <= RELATIVE_TOLERANCE * std::max(value[target], NEGLIGIBLE_MASS)) {
+                target++;
+            }
+            if (target >= out_size) {
+                break;
+            }
+
+            // The tilted result peaks around its mean index, which increases with the tilt
+            const auto mean = [&](double x) { return tilted_mean(log_a, x) + tilted_mean(log_b, x); };
+            double low = t, high = t + 1.;
+            while (mean(high) < target && high < 4096.) {
+                low = high;
+                high *= 2;
+            }
+            // Within one bin of the target is more than enough
+            for (int i = 0; i < 60 && high - low > 1e-3 * (high - t); i++) {
+                const double mid = (low + high) / 2;
+                (mean(mid) < target ? low : high) = mid;
+            }
+            t = high;
+        }
+
+        // Each bin is rounded up to an upper bound of the exact value
+        std::vector<double> out(out_size);
+        for (size_t k = 0; k < out_size; k++) {
+            out[k] = std::isfinite(bound[k]) ? value[k] + bound[k] : value[k];
+        }
+        return out;
+    }
+
+}   // namespace convolution
+
+/**
+ * @brief A distribution discretized on the grid x_k = k * step, k = 0 ... bins-1
+ *
+ * The mass of the interval (x_{k-1}, x_k] is assigned to x_k, i.e. values are rounded up to the
+ * next grid point, so the discretized distribution is an upper bound of the original one. The
+ * mass beyond the last grid point is kept as overflow: quantiles falling in the overflow are
+ * reported as infinite instead of being silently truncated.
+ */
+class DiscreteDistribution {
+
+public:
+
+    /**
+     * @brief Build the distribution from its probability mass function
+     * @param step      The grid step
+     * @param pmf       The probability mass of every grid point
+     * @param overflow  The probability mass beyond the last grid point
+     */
+    DiscreteDistribution(double step, std::vector<double> pmf, double overflow)
+        : step(step), pmf(std::move(pmf)), overflow(overflow) {
+        if (step <= 0. || this->pmf.empty()) {
+            throw std::invalid_argument("Invalid grid.");
+        }
+        compute_survival();
+    }
+
+    /**
+     * @brief Discretize an EVT distribution on `bins` grid points
+     */
+    DiscreteDistribution(const ResponseEVTDistribution &dist, double step, size_t bins)
+        : step(step), pmf(bins), overflow(0.) {
+        if (step <= 0. || bins == 0) {
+            throw std::invalid_argument("Invalid grid.");
+        }
+
+        std::vector<double> grid(bins);
+        for (size_t k = 0; k < bins; k++) {
+            grid[k] = k * step;
+        }
+        std::vector<double> surv(bins);
+        dist.get_exceedance(grid.data(), surv.data(), bins);
+
+        double prev = 1.;
+        for (size_t k = 0; k < bins; k++) {
+            this->pmf[k] = std::max(prev - surv[k], 0.);
+            prev = surv[k];
+        }
+        this->overflow = prev;
+        compute_survival();
+    }
+
+    /**
+     * @brief Discretize an EVT distribution on as many grid points as required to leave at most
+     *        `max_overflow` probability mass beyond the grid
+     */
+    static DiscreteDistribution from_evt(const ResponseEVTDistribution &dist, double step,
+                                         double max_overflow = 1e-18) {
+        if (step <= 0. || max_overflow <= 0.) {
+            throw std::invalid_argument("Invalid grid.");
+        }
+
+        // The upper end is searched on the exceedance, since 1 - max_overflow would lose all the
+        // digits of tiny probabilities
+        double low = 0., high = step;
+        for (int i = 0; i < 1100 && dist.get_exceedance(high) > max_overflow; i++) {
+            low = high;
+            high *= 2;
+        }
+        for (int i = 0; i < 100 && high - low > step; i++) {
+            const double mid = (low + high) / 2;
+            (dist.get_exceedance(mid) > max_overflow ? low : high) = mid;
+        }
+        return DiscreteDistribution(dist, step, static_cast<size_t>(std::ceil(high / step)) + 2);
+    }
+
+    /** @brief Getter for the grid step */
+    inline double get_step() const noexcept {
+        return this->step;
+    }
+
+    /** @brief Getter for the number of grid points */
+    inline size_t get_bins() const noexcept {
+        return this->pmf.size();
+    }
+
+    /** @brief Getter for the probability mass function */
+    inline const std::vector<double> &get_pmf() const noexcept {
+        return this->pmf;
+    }
+
+    /** @brief Getter for the probability mass beyond the grid */
+    inline double get_overflow() const noexcept {
+        return this->overflow;
+    }
+
+    /**
+     * @brief Upper bound of the quantile: the smallest grid point x such that P(X <= x) >= p.
+     *        Returns infinity if the quantile is beyond the grid.
+     */
+    double get_quantile(double p) const {
+        if (p <= 0. || p >= 1.) {
+            throw std::invalid_argument("The probability value is not valid.");
+        }
+        const double exceedance = 1. - p;
+
+        // survival is non-increasing: find the first point with P(X > x_k) <= exceedance
+        auto it = std::lower_bound(this->survival.cbegin(), this->survival.cend(), exceedance,
+                                   std::greater<double>());
+        if (it == this->survival.cend()) {
+            return std::numeric_limits<double>::infinity();
+        }
+        return (it - this->survival.cbegin()) * this->step;
+    }
+
+    /** @brief Upper bound of the exceedance probability P(X > x) */
+    double get_exceedance(double x) const noexcept {
+        if (x < 0.) {
+            return 1.;
+        }
+        const double k = std::floor(x / this->step);
+        if (k >= this->survival.size()) {
+            return this->overflow;
+        }
+        return this->survival[static_cast<size_t>(k)];
+    }
+
+private:
+    double step;
+    std::vector<double> pmf;
+    double overflow;
+    std::vector<double> survival;   /*!< P(X > x_k), accumulated from the tail */
+
+    void compute_survival() {
+        this->survival.resize(this->pmf.size());
+        double acc = this->overflow;
+        for (size_t k = this->pmf.size(); k-- > 0; ) {
+            this->survival[k] = std::min(acc, 1.);
+            acc += this->pmf[k];
+        }
+    }
+};
+
+/**
+ * @brief Distribution of the sum of two independent discretized distributions
+ *
+ * @param max_bins  If not zero, the result is truncated to max_bins grid points and the mass
+ *                  beyond them is moved to the overflow
+ */
+inline DiscreteDistribution convolve(const DiscreteDistribution &a, const DiscreteDistribution &b,
+                                     size_t max_bins = 0) {
+    if (a.get_step() != b.get_step()) {
+        throw std::invalid_argument("The distributions must be discretized on the same grid.");
+    }
+
+    std::vector<double> pmf = convolution::convolve(a.get_pmf(), b.get_pmf());
+
+    // The sum exceeds the grid as soon as one of the operands does
+    const double oa = a.get_overflow();
+    const double ob = b.get_overflow();
+    double overflow = oa + ob - oa * ob;
+
+    if (max_bins != 0 && pmf.size() > max_bins) {
+        for (size_t k = max_bins; k < pmf.size(); k++) {
+            overflow += pmf[k];
+        }
+        pmf.resize(max_bins);
+    }
+
+    return DiscreteDistribution(a.get_step(), std::move(pmf), std::min(overflow, 1.));
+}
+
+/**
+ * @brief Distribution of the sum of the execution times of a chain of independent tasks
+ *
+ * @param step          The grid step
+ * @param max_overflow  The maximum mass left beyond the grid when discretizing each task
+ * @param max_bins      If not zero, the maximum number of grid points of the result
+ */
+inline DiscreteDistribution convolve(const std::vector<std::shared_ptr<ResponseEVTDistribution>> &chain,
+                                     double step, double max_overflow = 1e-18, size_t max_bins = 0) {
+    if (chain.empty()) {
+        throw std::invalid_argument("Empty task chain.");
+    }
+
+    DiscreteDistribution result = DiscreteDistribution::from_evt(*chain[0], step, max_overflow);
+    for (size_t i = 1; i < chain.size(); i++) {
+        result = convolve(result, DiscreteDistribution::from_evt(*chain[i], step, max_overflow),
+                          max_bins);
+    }
+    return result;
+}
+
+}    // libta
+
+#endif // LIBTA_CONVOLUTION_H_
@@ -0,0 +1,129 @@
+/** @file libta_decimation.h
+ * Decimation of huge execution time traces.
+ *
+ * The tail estimate depends only on the extreme part of the distribution, so a trace can be
+ * reduced by keeping all the samples above a conservative pre-threshold (the tail) and only a
+ * subsample of the remaining ones (the body). The body is sampled systematically in the original
+ * order of the trace, so that every stratum of the execution (e.g. every phase of a long test
+ * campaign) is represented proportionally.
+ *
+ * @copyright
+ * Copyright 2020 Politecnico di Milano
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef LIBTA_DECIMATION_H_
+#define LIBTA_DECIMATION_H_
+
+#include "libta.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace libta {
+
+/**
+ * @brief The effect of a decimation
+ *
+ * decimate() fills the size fields and the pre-threshold. The analyzers supporting a decimated
+ * analysis (e.g. BSCTimingAnalyzer::perform_decimated_analysis()) also report the outcome of the
+ * threshold selection on the kept tail.
+ */
+struct DecimationReport {
+    size_t input_samples = 0;   /*!< Number of samples of the original trace */
+    size_t tail_samples = 0;    /*!< Number of samples kept above (or at) the pre-threshold */
+    size_t body_samples = 0;    /*!< Number of samples kept below the pre-threshold */
+    double pre_threshold = 0.;  /*!< The smallest sample of the kept tail */
+    size_t nelems = 0;          /*!< Number of tail samples selected by the analysis */
+    bool saturated = false;     /*!< True if the selection reached the pre-threshold at least once */
+    int rounds = 0;             /*!< Number of times the tail has been scanned */
+};
+
+/**
+ * @brief Reduce a trace to its top `tail` samples plus `body` samples of the rest
+ *
+ * The result contains the samples in their original order. The cost is linear in the trace size.
+ * If the trace is not larger than tail + body, it is returned unchanged.
+ *
+ * @param report  If not null, filled with the effect of the decimation
+ */
+template <typename T>
+Request<T> decimate(const Request<T> &req, size_t tail, size_t body,
+                    DecimationReport *report = nullptr) {
+    const auto &values = req.get_all();
+    const size_t n = values.size();
+
+    if (n <= tail + body || tail == 0) {
+        if (report != nullptr) {
+            *report = DecimationReport();
+            report->input_samples = n;
+            report->tail_samples  = std::min(tail, n);
+            report->body_samples  = n - report->tail_samples;
+            if (tail > 0 && n > 0) {
+                std::vector<T> top(values);
+                std::nth_element(top.begin(), top.begin() + report->tail_samples - 1, top.end(),
+                                 std::greater<T>());
+                report->pre_threshold = static_cast<double>(top[report->tail_samples - 1]);
+            }
+        }
+        return Request<T>(values.cbegin(), values.cend());
+    }
+
+    // The pre-threshold is the tail-th largest sample
+    std::vector<T> top(values);
+    std::nth_element(top.begin(), top.begin() + tail - 1, top.end(), std::greater<T>());
+    const T pre_threshold = top[tail - 1];
+    const size_t above = std::count_if(top.cbegin(), top.cbegin() + tail - 1,
+                                       [pre_threshold](const T &v) { return v > pre_threshold; });
+    top.clear();
+    top.shrink_to_fit();
+
+    // Samples equal to the pre-threshold are kept in the tail up to the requested size
+    size_t ties = tail - above;
+    const uint64_t rest = n - tail;
+
+    std::vector<T> out;
+    out.reserve(tail + body);
+    uint64_t j = 0;
+    for (const auto &v : values) {
+        if (v > pre_threshold || (v == pre_threshold && ties > 0)) {
+            if (! (v > pre_threshold)) {
+                ties--;
+            }
+            out.push_back(v);
+            continue;
+        }
+        // Systematic sampling: exactly one sample for each of the `body` strata of the body
+        if ((j + 1) * body / rest != j * body / rest) {
+            out.push_back(v);
+        }
+        j++;
+    }
+
+    if (report != nullptr) {
+        *report = DecimationReport();
+        report->input_samples = n;
+        report->tail_samples  = tail;
+        report->body_samples  = body;
+        report->pre_threshold = static_cast<double>(pre_threshold);
+    }
+
+    return Request<T>(std::move(out));
+}
+
+}    // libta
+
+#endif // LIBTA_DECIMATION_H_
@@ -0,0 +1,168 @@
+/** @file libta_envelope.h
+ * Envelope of pWCET distributions.
+ *
+ * The envelope combines the distributions estimated for different input scenarios, modes or
+ * cores of the same task into a single bound: for every probability, the envelope quantile is the
+ * largest quantile among the components.
+ *
+ * @copyright
+ * Copyright 2020 Politecnico di Milano
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef LIBTA_ENVELOPE_H_
+#define LIBTA_ENVELOPE_H_
+
+#include "libta.h"
+
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace libta {
+
+/**
+ * @brief The envelope (pointwise maximum of the exceedance curves) of N EVT distributions
+ *
+ * The exceedance function of the envelope is the maximum of the components ones, so its quantile
+ * at any probability is the maximum of the components quantiles. Since every component has a
+ * closed-form quantile, no root-finding or sampling is needed.
+ *
+ * The components are stored as structure-of-arrays, and every GEV/GPD quantile is rewritten as
+ * mu + sigma * g(xi, t), where t depends only on p and on the distribution family. t is computed
+ * once per query for all the components, so a query costs one log/expm1 per component with a
+ * xi different from zero and a multiply-add otherwise.
+ */
+class ResponseEVTEnvelope : public Response {
+
+public:
+
+    typedef ResponseEVTDistribution::parameters_t parameters_t;
+
+    ResponseEVTEnvelope() noexcept : Response(response_type_t::PWCET_ENVELOPE) {
+
+    }
+
+    virtual ~ResponseEVTEnvelope() = default;
+
+    /** @brief Add a component to the envelope */
+    void add(distribution_type_t dist_type, const parameters_t &params) {
+        this->gev.push_back(dist_type == distribution_type_t::EVT_GEV ? 1 : 0);
+        this->mu.push_back(std::get<ResponseEVTDistribution::P_MU>(params));
+        this->sigma.push_back(std::get<ResponseEVTDistribution::P_SIGMA>(params));
+        this->xi.push_back(std::get<ResponseEVTDistribution::P_XI>(params));
+        this->has_gev = this->has_gev || this->gev.back() != 0;
+        this->has_gpd = this->has_gpd || this->gev.back() == 0;
+    }
+
+    /** @brief Add a component to the envelope */
+    inline void add(const ResponseEVTDistribution &dist) {
+        add(dist.get_dist_type(), dist.get_parameters());
+    }
+
+    /** @brief Getter for the number of components */
+    inline size_t size() const noexcept {
+        return this->mu.size();
+    }
+
+    /**
+     * @brief Quantile of the envelope. As in ResponseEVTDistribution::get_quantile(), p is the
+     *        probability of NOT exceeding the returned value.
+     */
+    double get_quantile(double p) const {
+        double q;
+        get_quantiles(&p, &q, 1);
+        return q;
+    }
+
+    /** @brief Quantiles of the envelope for n probabilities */
+    void get_quantiles(const double *p, double *out, size_t n) const {
+        for(size_t j=0; j<n; j++) {
+            out[j] = eval(p[j], nullptr);
+        }
+    }
+
+    /** @brief The index of the component that determines the envelope at probability p */
+    size_t get_dominant(double p) const {
+        size_t idx;
+        eval(p, &idx);
+        return idx;
+    }
+
+private:
+    std::vector<uint8_t> gev;   /*!< 1 for a GEV component, not a packed std::vector<bool> */
+    std::vector<double>  mu;
+    std::vector<double>  sigma;
+    std::vector<double>  xi;
+    bool has_gev = false;
+    bool has_gpd = false;
+
+    double eval(double p, size_t *dominant) const {
+        if (p <= 0. || p >= 1.) {
+            throw std::invalid_argument("The probability value is not valid.");
+        }
+        if (this->mu.empty()) {
+            throw std::logic_error("The envelope has no components.");
+        }
+
+        // GPD: q = mu + sg * (exp(xi * t) - 1) / xi,  t = -log(1-p)
+        // GEV: q = mu + sg * (exp(xi * t) - 1) / xi,  t = -log(-log(p))
+        // with the limit q = mu + sg * t for xi = 0
+        const double t_gpd = this->has_gpd ? -std::log1p(-p) : 0.;
+        const double t_gev = this->has_gev ? -std::log(-std::log(p)) : 0.;
+
+        double best = -std::numeric_limits<double>::infinity();
+        size_t best_idx = 0;
+        const size_t size = this->mu.size();
+        for(size_t i=0; i<size; i++) {
+            const double t = this->gev[i] != 0 ? t_gev : t_gpd;
+            const double x = this->xi[i];
+            const double g = (x == 0.) ? t : std::expm1(x * t) / x;
+            const double q = this->mu[i] + this->sigma[i] * g;
+            if (q > best) {
+                best = q;
+                best_idx = i;
+            }
+        }
+
+        if (dominant != nullptr) {
+            *dominant = best_idx;
+        }
+        return best;
+    }
+};
+
+/**
+ * @brief Build the envelope of the given distributions
+ */
+template <typename InputIt>
+std::shared_ptr<ResponseEVTEnvelope> make_envelope(InputIt first, InputIt last) {
+    auto env = std::make_shared<ResponseEVTEnvelope>();
+    for(; first != last; ++first) {
+        env->add(**first);
+    }
+    return env;
+}
+
+/**
+ * @brief Build the envelope of the given distributions
+ */
+inline std::shared_ptr<ResponseEVTEnvelope> make_envelope(
+                                const std::vector<std::shared_ptr<ResponseEVTDistribution>> &dists) {
+    return make_envelope(dists.cbegin(), dists.cend());
+}
+
+}    // libta
+
+#endif // LIBTA_ENVELOPE_H_
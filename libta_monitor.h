@@ -0,0 +1,212 @@
+/** @file libta_monitor.h
+ * Online detection of changes in the timing behaviour.
+ *
+ * Re-estimating the pWCET of a task whose timing behaviour did not change is a waste of CPU.
+ * The ChangeDetector observes the execution times as they are collected and tells when the
+ * distribution has shifted, so that the caller can skip the analysis until then. Two cheap tests
+ * are combined, both O(1) per sample:
+ *  - the two-sided Page-Hinkley test, that detects a shift of the mean in either direction;
+ *  - an exceedance-rate test against the last estimated distribution: the samples exceeding its
+ *    quantile at a given exceedance probability must not be significantly more than expected.
+ *    This catches changes of the tail that leave the mean unchanged.
+ *
+ * @copyright
+ * Copyright 2020 Politecnico di Milano
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef LIBTA_MONITOR_H_
+#define LIBTA_MONITOR_H_
+
+#include "libta.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace libta {
+
+/**
+ * @brief Streaming change-point detector of execution times
+ *
+ * Typical usage:
+ * @code
+ * detector.update(*req);
+ * if (detector.is_changed()) {
+ *     auto dist = analyzer.perform_analysis(req);
+ *     detector.set_reference(*std::static_pointer_cast<ResponseEVTDistribution>(dist), 1e-3);
+ * }
+ * @endcode
+ */
+template <typename T>
+class ChangeDetector {
+
+public:
+
+    /**
+     * @brief The ChangeDetector class constructor
+     * @param delta   The magnitude of the mean changes tolerated, in the time unit of the samples
+     * @param lambda  The Page-Hinkley alarm threshold: higher values mean less false alarms and
+     *                longer detection delays
+     * @param warmup  The number of samples observed before any alarm is raised
+     */
+    ChangeDetector(double delta, double lambda, size_t warmup = 30)
+        : delta(delta), lambda(lambda), warmup(warmup) {
+        if (delta < 0. || lambda <= 0.) {
+            throw std::invalid_argument("Invalid Page-Hinkley parameters.");
+        }
+        reset();
+    }
+
+    virtual ~ChangeDetector() = default;
+
+    /**
+     * @brief Set the distribution used by the exceedance-rate test and restart the detection
+     * @param dist         The last estimated distribution
+     * @param exceedance   The exceedance probability of the monitored quantile
+     * @param z            The number of standard deviations of the binomial count of
+     *                     exceedances tolerated
+     */
+    void set_reference(const ResponseEVTDistribution &dist, double exceedance, double z = 3.) {
+        if (exceedance <= 0. || exceedance >= 1. || z <= 0.) {
+            throw std::invalid_argument("Invalid exceedance test parameters.");
+        }
+        this->reference_quantile = dist.get_quantile(1. - exceedance);
+        this->reference_p = exceedance;
+        this->reference_z = z;
+        reset();
+    }
+
+    /** @brief Restart the detection, e.g. after a re-estimation. The reference is kept. */
+    void reset() noexcept {
+        this->count = 0;
+        this->mean = 0.;
+        this->sum_up = this->min_up = 0.;
+        this->sum_down = this->max_down = 0.;
+        this->exceedances = 0;
+        this->mean_shift = false;
+        this->exceedance_excess = false;
+    }
+
+    /**
+     * @brief Observe a new sample
+     * @return True if a change has been detected (now or before the last reset())
+     */
+    bool add_value(const T &value) noexcept {
+        const double x = static_cast<double>(value);
+        this->count++;
+        this->mean += (x - this->mean) / this->count;
+
+        // Page-Hinkley: cumulative deviations from the running mean, compared with their
+        // extreme values so far
+        this->sum_up += x - this->mean - this->delta;
+        this->min_up = std::min(this->min_up, this->sum_up);
+        this->sum_down += x - this->mean + this->delta;
+        this->max_down = std::max(this->max_down, this->sum_down);
+
+        if (x > this->reference_quantile) {
+            this->exceedances++;
+        }
+
+        if (this->count >= this->warmup) {
+            if (this->sum_up - this->min_up > this->lambda
+                || this->max_down - this->sum_down > this->lambda) {
+                this->mean_shift = true;
+            }
+            const double expected = this->count * this->reference_p;
+            const double limit = expected
+                               + this->reference_z * std::sqrt(expected * (1. - this->reference_p));
+            // At least a few exceedances are needed before the normal approximation is of any use
+            if (this->exceedances > std::max(limit, this->reference_z * this->reference_z)) {
+                this->exceedance_excess = true;
+            }
+        }
+
+        return is_changed();
+    }
+
+    /** @brief Observe the samples of an iterator range */
+    template <typename InputIt>
+    bool add_values(InputIt first, InputIt last) noexcept {
+        for (; first != last; ++first) {
+            add_value(*first);
+        }
+        return is_changed();
+    }
+
+    /**
+     * @brief Observe the samples appended to the request since the last call
+     *
+     * The detector remembers the append counter of the request (see Request::get_appended()), so
+     * the request can be cleared and refilled, or trimmed to a window of its most recent values.
+     * The new samples already discarded from the request are not observed.
+     */
+    bool update(const Request<T> &req) noexcept {
+        const auto &values = req.get_all();
+        const uint64_t appended = req.get_appended();
+        // A smaller counter means a different request: observe it from its beginning
+        const uint64_t fresh = appended >= this->observed ? appended - this->observed : appended;
+        add_values(values.cend() - std::min<uint64_t>(fresh, values.size()), values.cend());
+        this->observed = appended;
+        return is_changed();
+    }
+
+    /** @brief True if the distribution changed since the last reset() */
+    inline bool is_changed() const noexcept {
+        return this->mean_shift || this->exceedance_excess;
+    }
+
+    /** @brief True if the Page-Hinkley test detected a shift of the mean */
+    inline bool is_mean_shift() const noexcept {
+        return this->mean_shift;
+    }
+
+    /** @brief True if the reference quantile is exceeded more often than expected */
+    inline bool is_exceedance_excess() const noexcept {
+        return this->exceedance_excess;
+    }
+
+    /** @brief Getter for the number of samples observed since the last reset() */
+    inline size_t get_count() const noexcept {
+        return this->count;
+    }
+
+    /** @brief Getter for the number of samples exceeding the reference quantile */
+    inline size_t get_exceedances() const noexcept {
+        return this->exceedances;
+    }
+
+private:
+    const double delta;
+    const double lambda;
+    const size_t warmup;
+
+    double reference_quantile = std::numeric_limits<double>::infinity();
+    double reference_p = 0.;
+    double reference_z = 0.;
+
+    uint64_t observed = 0;  /*!< Append counter of the request at the last update() */
+
+    size_t count;
+    double mean;
+    double sum_up, min_up;
+    double sum_down, max_down;
+    size_t exceedances;
+    bool mean_shift;
+    bool exceedance_excess;
+};
+
+}    // libta
+
+#endif // LIBTA_MONITOR_H_
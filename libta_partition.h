@@ -0,0 +1,139 @@
+/** @file libta_partition.h
+ * Partitioned analysis of tagged requests.
+ *
+ * The samples of a tagged Request come from different contexts (input classes, cores, frequency
+ * levels...) and must not be mixed in a single tail fit. A partitioned analysis groups the samples
+ * by tag and estimates one distribution per tag, optionally with the envelope of all of them,
+ * so that a single buffer can be collected and analyzed in a single call.
+ *
+ * @copyright
+ * Copyright 2020 Politecnico di Milano
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef LIBTA_PARTITION_H_
+#define LIBTA_PARTITION_H_
+
+#include "libta.h"
+#include "libta_envelope.h"
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+namespace libta {
+
+/**
+ * @brief The values of a request grouped by tag
+ *
+ * The values are reordered with a counting sort on the tags, so the values of every tag are
+ * contiguous and keep their original order. An untagged request has a single partition, tag 0.
+ */
+template <typename T>
+class RequestPartitions {
+
+public:
+
+    explicit RequestPartitions(const Request<T> &req) {
+        const auto &times = req.get_all();
+        const auto &tags = req.get_tags();
+        if (tags.empty()) {
+            this->values = times;
+            if (! times.empty()) {
+                this->tags.push_back(0);
+                this->offsets = {0, times.size()};
+            }
+            return;
+        }
+
+        const tag_t max_tag = *std::max_element(tags.cbegin(), tags.cend());
+        std::vector<size_t> position(static_cast<size_t>(max_tag) + 1, 0);
+        for (tag_t tag : tags) {
+            position[tag]++;
+        }
+
+        // Turn the counts into the first position of every non-empty partition
+        size_t offset = 0;
+        for (size_t tag = 0; tag < position.size(); tag++) {
+            const size_t count = position[tag];
+            if (count != 0) {
+                this->tags.push_back(static_cast<tag_t>(tag));
+                this->offsets.push_back(offset);
+            }
+            position[tag] = offset;
+            offset += count;
+        }
+        this->offsets.push_back(offset);
+
+        this->values.resize(times.size());
+        for (size_t i = 0; i < times.size(); i++) {
+            this->values[position[tags[i]]++] = times[i];
+        }
+    }
+
+    /** @brief Getter for the number of partitions, i.e. of distinct tags */
+    inline size_t size() const noexcept {
+        return this->tags.size();
+    }
+
+    /** @brief Getter for the tag of the i-th partition. The tags are in increasing order. */
+    inline tag_t get_tag(size_t i) const noexcept {
+        return this->tags[i];
+    }
+
+    /** @brief Getter for the values of the i-th partition */
+    inline const T *get_values(size_t i) const noexcept {
+        return this->values.data() + this->offsets[i];
+    }
+
+    /** @brief Getter for the number of values of the i-th partition */
+    inline size_t get_count(size_t i) const noexcept {
+        return this->offsets[i + 1] - this->offsets[i];
+    }
+
+private:
+    std::vector<T> values;
+    std::vector<tag_t> tags;
+    std::vector<size_t> offsets;
+};
+
+/**
+ * @brief The result of the analysis of one partition
+ */
+template <typename T>
+struct PartitionResult {
+    tag_t tag;
+    size_t samples;             /*!< Number of samples of the partition */
+    AnalysisResult<T> result;   /*!< The distribution, or the error if it cannot be estimated */
+};
+
+/**
+ * @brief The result of a partitioned analysis
+ */
+template <typename T>
+struct PartitionedResult {
+    std::vector<PartitionResult<T>> partitions;    /*!< One per tag, in increasing tag order */
+    std::shared_ptr<ResponseEVTEnvelope> envelope;  /*!< Of all the distributions, if requested */
+
+    /** @brief The result of the given tag, nullptr if the request has no such tag */
+    const PartitionResult<T> *find(tag_t tag) const noexcept {
+        auto it = std::lower_bound(this->partitions.cbegin(), this->partitions.cend(), tag,
+                                   [](const PartitionResult<T> &p, tag_t t) { return p.tag < t; });
+        return it != this->partitions.cend() && it->tag == tag ? &*it : nullptr;
+    }
+};
+
+}    // libta
+
+#endif // LIBTA_PARTITION_H_
@@ -0,0 +1,160 @@
+/** @file libta_perf.h
+ * Hardware performance counters of the calling thread.
+ *
+ * On Linux the counters are read with perf_event_open(2): CPU cycles, retired instructions,
+ * last-level cache misses and branch misses are opened as a single group, so that they are
+ * always scheduled together and their ratios are meaningful. The events count user-space only.
+ *
+ * The counters are not always available: the kernel may not permit them (see
+ * /proc/sys/kernel/perf_event_paranoid), the machine may have no PMU (e.g. most virtual
+ * machines) or the platform may not be Linux. In such cases available() returns false and read()
+ * returns zeros, the analyses are not affected.
+ *
+ * @copyright
+ * Copyright 2020 Politecnico di Milano
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef LIBTA_PERF_H_
+#define LIBTA_PERF_H_
+
+#include <cstdint>
+#include <cstring>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace libta {
+
+/**
+ * @brief The hardware events counted
+ */
+typedef enum class counter_e {
+    CYCLES,         /*!< CPU cycles */
+    INSTRUCTIONS,   /*!< Retired instructions */
+    CACHE_MISSES,   /*!< Last-level cache misses */
+    BRANCH_MISSES,  /*!< Mispredicted branches */
+    COUNT           /*!< Number of counters, not a counter */
+} counter_t;
+
+/**
+ * @brief A group of hardware counters attached to the calling thread
+ *
+ * The counters are opened once per thread by get() and closed when the thread exits.
+ */
+class PerfCounters {
+
+public:
+
+    static constexpr int COUNTERS = static_cast<int>(counter_t::COUNT);
+
+    /** @brief The counters of the calling thread */
+    static PerfCounters &get() noexcept {
+        static thread_local PerfCounters counters;
+        return counters;
+    }
+
+    PerfCounters(const PerfCounters &) = delete;
+    PerfCounters &operator=(const PerfCounters &) = delete;
+
+    ~PerfCounters() {
+        close_all();
+    }
+
+    /** @brief True if the counters could be opened */
+    inline bool available() const noexcept {
+        return this->fd[0] >= 0;
+    }
+
+    /**
+     * @brief Read the current value of all the counters
+     * @return false (and zeros) if the counters are not available
+     */
+    bool read(uint64_t (&values)[COUNTERS]) const noexcept {
+        std::memset(values, 0, sizeof(values));
+#ifdef __linux__
+        if (! available()) {
+            return false;
+        }
+        // Layout of PERF_FORMAT_GROUP: the number of events followed by their values
+        uint64_t buf[1 + COUNTERS];
+        if (::read(this->fd[0], buf, sizeof(buf)) != static_cast<ssize_t>(sizeof(buf))
+            || buf[0] != COUNTERS) {
+            return false;
+        }
+        std::memcpy(values, buf + 1, sizeof(values));
+        return true;
+#else
+        return false;
+#endif
+    }
+
+private:
+
+    int fd[COUNTERS];
+
+    PerfCounters() noexcept {
+        for (int i = 0; i < COUNTERS; i++) {
+            this->fd[i] = -1;
+        }
+#ifdef __linux__
+        static const uint64_t configs[COUNTERS] = {
+            PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+            PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES
+        };
+
+        for (int i = 0; i < COUNTERS; i++) {
+            struct perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size           = sizeof(attr);
+            attr.type           = PERF_TYPE_HARDWARE;
+            attr.config         = configs[i];
+            attr.disabled       = (i == 0);     // The group is enabled through the leader
+            attr.exclude_kernel = 1;
+            attr.exclude_hv     = 1;
+            attr.read_format    = PERF_FORMAT_GROUP;
+
+            const long fd = syscall(SYS_perf_event_open, &attr, 0, -1, this->fd[0], 0);
+            if (fd < 0) {
+                close_all();
+                return;
+            }
+            this->fd[i] = static_cast<int>(fd);
+        }
+
+        if (ioctl(this->fd[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP) != 0) {
+            close_all();
+        }
+#endif
+    }
+
+    void close_all() noexcept {
+#ifdef __linux__
+        for (int i = COUNTERS; i-- > 0; ) {
+            if (this->fd[i] >= 0) {
+                close(this->fd[i]);
+                this->fd[i] = -1;
+            }
+        }
+#endif
+    }
+};
+
+}    // libta
+
+#endif // LIBTA_PERF_H_
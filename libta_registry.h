@@ -0,0 +1,264 @@
+/** @file libta_registry.h
+ * A shared memory registry of the estimated distributions.
+ *
+ * The analysis service publishes the parameters of the last distribution of every task in a
+ * memory-mapped table, and any number of readers (e.g. the schedulers, in other processes) read
+ * them directly, without sockets, locks or syscalls.
+ *
+ * Every slot is protected by a sequence lock: the writer makes the sequence number odd, updates
+ * the slot and makes it even again, the readers retry if the number was odd or changed during the
+ * read. Readers never block the writer, and they always observe a consistent snapshot. All the
+ * slot fields are atomics accessed with relaxed ordering, so the concurrent accesses are not
+ * data races; the ordering is given by the fences around them.
+ *
+ * @copyright
+ * Copyright 2020 Politecnico di Milano
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef LIBTA_REGISTRY_H_
+#define LIBTA_REGISTRY_H_
+
+#include "libta.h"
+#include "libta_shm.h"
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+
+namespace libta {
+
+namespace shm {
+
+    static constexpr uint32_t REGISTRY_MAGIC   = 0x4c545247;   // "LTRG"
+    static constexpr uint32_t REGISTRY_VERSION = 1;
+
+    /** @brief One task of the registry, on its own cache line */
+    struct alignas(CACHE_LINE) RegistrySlot {
+        std::atomic<int64_t>  key;          /*!< Task identifier, EMPTY_KEY if free */
+        std::atomic<uint64_t> seq;          /*!< Odd while the writer updates the slot */
+        std::atomic<uint64_t> dist_type;
+        std::atomic<uint64_t> params[4];    /*!< Bit patterns of mu, sigma, xi, threshold */
+    };
+
+    struct RegistryHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t slots;
+    };
+
+    static constexpr int64_t EMPTY_KEY = INT64_MIN;
+
+    inline size_t registry_size(size_t slots) noexcept {
+        return CACHE_LINE + slots * sizeof(RegistrySlot);
+    }
+
+}   // namespace shm
+
+/**
+ * @brief The registry of the distributions, keyed by task identifier
+ *
+ * There must be a single writer, which creates the registry. The slots are assigned on the first
+ * publication of a task and never released.
+ */
+class DistributionRegistry {
+
+public:
+
+    typedef ResponseEVTDistribution::parameters_t parameters_t;
+
+    /**
+     * @brief Map an existing registry or, if slots is not zero, create a new one
+     * @param name   The name of the shared memory object, e.g. "/libta.registry"
+     * @param slots  The maximum number of tasks
+     */
+    DistributionRegistry(const std::string &name, size_t slots = 0)
+        : name(name), owner(slots != 0) {
+        void *addr = shm::map_object(name, slots != 0 ? shm::registry_size(slots) : 0,
+                                     shm::registry_size(0), this->size);
+        this->header = static_cast<shm::RegistryHeader*>(addr);
+        this->slots = reinterpret_cast<shm::RegistrySlot*>(static_cast<char*>(addr)
+                                                           + shm::CACHE_LINE);
+
+        if (this->owner) {
+            for (size_t i = 0; i < slots; i++) {
+                shm::RegistrySlot *slot = new (&this->slots[i]) shm::RegistrySlot;
+                slot->key.store(shm::EMPTY_KEY, std::memory_order_relaxed);
+                slot->seq.store(0, std::memory_order_relaxed);
+            }
+            this->header->slots = slots;
+            this->header->version = shm::REGISTRY_VERSION;
+            std::atomic_thread_fence(std::memory_order_release);
+            this->header->magic = shm::REGISTRY_MAGIC;
+        } else if (this->header->magic != shm::REGISTRY_MAGIC
+                   || this->header->version != shm::REGISTRY_VERSION
+                   || this->header->slots == 0
+                   || this->header->slots
+                      > (this->size - shm::CACHE_LINE) / sizeof(shm::RegistrySlot)) {
+            munmap(addr, this->size);
+            throw std::runtime_error("Incompatible distribution registry " + name);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        this->nslots = this->header->slots;
+    }
+
+    DistributionRegistry(const DistributionRegistry &) = delete;
+    DistributionRegistry &operator=(const DistributionRegistry &) = delete;
+
+    /** @brief The writer owns the registry: the shared memory object is removed */
+    virtual ~DistributionRegistry() {
+        munmap(this->header, this->size);
+        if (this->owner) {
+            shm_unlink(this->name.c_str());
+        }
+    }
+
+    /** @brief Getter for the maximum number of tasks */
+    inline size_t get_slots() const noexcept {
+        return this->nslots;
+    }
+
+    /**
+     * @brief Publish the distribution of a task. Only the writer can publish.
+     * @return false if the registry is full
+     */
+    bool publish(int id, distribution_type_t dist_type, const parameters_t &params) {
+        if (! this->owner) {
+            throw std::logic_error("Only the creator of the registry can publish.");
+        }
+        shm::RegistrySlot *slot = find(id, true);
+        if (slot == nullptr) {
+            return false;
+        }
+
+        const uint64_t seq = slot->seq.load(std::memory_order_relaxed);
+        slot->seq.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        slot->dist_type.store(static_cast<uint64_t>(dist_type), std::memory_order_relaxed);
+        slot->params[0].store(to_bits(std::get<ResponseEVTDistribution::P_MU>(params)),
+                              std::memory_order_relaxed);
+        slot->params[1].store(to_bits(std::get<ResponseEVTDistribution::P_SIGMA>(params)),
+                              std::memory_order_relaxed);
+        slot->params[2].store(to_bits(std::get<ResponseEVTDistribution::P_XI>(params)),
+                              std::memory_order_relaxed);
+        slot->params[3].store(to_bits(std::get<ResponseEVTDistribution::P_THRSH>(params)),
+                              std::memory_order_relaxed);
+
+        slot->seq.store(seq + 2, std::memory_order_release);
+
+        // The key is published after the content, so readers never find an empty slot
+        if (slot->key.load(std::memory_order_relaxed) != id) {
+            slot->key.store(id, std::memory_order_release);
+        }
+        return true;
+    }
+
+    /** @brief Publish the distribution of a task. Only the writer can publish. */
+    inline bool publish(int id, const ResponseEVTDistribution &dist) {
+        return publish(id, dist.get_dist_type(), dist.get_parameters());
+    }
+
+    /**
+     * @brief Read a consistent snapshot of the distribution of a task. Lock-free.
+     * @param version  If not null, set to the number of publications of the task so far, so
+     *                 that readers can cheaply detect a new result
+     * @return false if the task has never been published
+     */
+    bool lookup(int id, distribution_type_t &dist_type, parameters_t &params,
+                uint64_t *version = nullptr) const noexcept {
+        const shm::RegistrySlot *slot = const_cast<DistributionRegistry*>(this)->find(id, false);
+        if (slot == nullptr) {
+            return false;
+        }
+
+        uint64_t seq, type, p[4];
+        do {
+            seq = slot->seq.load(std::memory_order_acquire);
+            type = slot->dist_type.load(std::memory_order_relaxed);
+            for (int i = 0; i < 4; i++) {
+                p[i] = slot->params[i].load(std::memory_order_relaxed);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+        } while ((seq & 1) != 0 || seq != slot->seq.load(std::memory_order_relaxed));
+
+        dist_type = static_cast<distribution_type_t>(type);
+        params = std::make_tuple(from_bits(p[0]), from_bits(p[1]), from_bits(p[2]), from_bits(p[3]));
+        if (version != nullptr) {
+            *version = seq / 2;
+        }
+        return true;
+    }
+
+    /** @brief The distribution of a task, nullptr if never published */
+    std::shared_ptr<ResponseEVTDistribution> get(int id) const {
+        distribution_type_t dist_type;
+        parameters_t params;
+        if (! lookup(id, dist_type, params)) {
+            return nullptr;
+        }
+        auto dist = std::make_shared<ResponseEVTDistribution>(dist_type);
+        dist->set_parameters(params);
+        return dist;
+    }
+
+    /** @brief The number of publications of a task, 0 if never published. Lock-free. */
+    uint64_t get_version(int id) const noexcept {
+        const shm::RegistrySlot *slot = const_cast<DistributionRegistry*>(this)->find(id, false);
+        return slot == nullptr ? 0 : slot->seq.load(std::memory_order_acquire) / 2;
+    }
+
+private:
+    const std::string name;
+    const bool owner;
+
+    shm::RegistryHeader *header;
+    shm::RegistrySlot *slots;
+    size_t nslots;
+    size_t size;
+
+    static inline uint64_t to_bits(double v) noexcept {
+        uint64_t bits;
+        std::memcpy(&bits, &v, sizeof(bits));
+        return bits;
+    }
+
+    static inline double from_bits(uint64_t bits) noexcept {
+        double v;
+        std::memcpy(&v, &bits, sizeof(v));
+        return v;
+    }
+
+    /** @brief Open addressing with linear probing. Only the writer claims free slots. */
+    shm::RegistrySlot *find(int id, bool claim) noexcept {
+        const size_t start = static_cast<uint32_t>(id) * 2654435761u % this->nslots;
+        for (size_t i = 0; i < this->nslots; i++) {
+            shm::RegistrySlot *slot = &this->slots[(start + i) % this->nslots];
+            const int64_t key = slot->key.load(std::memory_order_acquire);
+            if (key == id) {
+                return slot;
+            }
+            if (key == shm::EMPTY_KEY) {
+                return claim ? slot : nullptr;
+            }
+        }
+        return nullptr;
+    }
+};
+
+}    // libta
+
+#endif // LIBTA_REGISTRY_H_
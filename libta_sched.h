@@ -0,0 +1,288 @@
+/** @file libta_sched.h
+ * Probabilistic schedulability analysis of fixed-priority task sets.
+ *
+ * Every task is described by its pWCET distribution (a ResponseEVTDistribution), its period, its
+ * relative deadline and its priority. The response time distribution of every task is computed
+ * with the probabilistic response time analysis for fixed-priority preemptive scheduling
+ * (Diaz et al., "Stochastic analysis of periodic real-time systems", RTSS 2002): starting from the
+ * critical instant, the backlog is the convolution of the execution times of the task and of all
+ * the higher priority tasks, then at every release of a higher priority job the part of the
+ * distribution still running is convolved with the execution time of the preempting job.
+ *
+ * @copyright
+ * Copyright 2020 Politecnico di Milano
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef LIBTA_SCHED_H_
+#define LIBTA_SCHED_H_
+
+#include "libta.h"
+#include "libta_convolution.h"
+
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+namespace libta {
+
+/**
+ * @brief A set of periodic tasks scheduled with preemptive fixed priorities
+ *
+ * All the distributions are discretized on a common grid with the given step, covering the
+ * interval [0, horizon]. Deadlines cannot exceed the horizon: the probability mass beyond it is
+ * accounted as a deadline miss, so the results are always safe.
+ *
+ * Deadlines cannot exceed the periods either: the analysis assumes that every job of a task
+ * completes (or is aborted) before the next one is released, so the backlog left by the previous
+ * jobs of the task itself is not modelled.
+ *
+ * The analysis is incremental: the discretized execution times, the convolution of the execution
+ * times of each priority prefix and the response time distributions are cached. Adding or
+ * removing a task only invalidates the results of the tasks with lower priority, and the cached
+ * prefix of the higher priority tasks is reused. Results are recomputed lazily on request.
+ *
+ * @note Priorities must be unique, and a higher value means a higher priority.
+ */
+class TaskSet {
+
+public:
+
+    /**
+     * @brief The TaskSet class constructor
+     * @param step          The grid step, in the same time unit of the distributions
+     * @param horizon       The largest deadline that can be analyzed
+     * @param max_overflow  The maximum mass left beyond the grid when discretizing each task
+     */
+    TaskSet(double step, double horizon, double max_overflow = 1e-18)
+        : step(step), bins(static_cast<size_t>(std::floor(horizon / step)) + 1),
+          max_overflow(max_overflow), valid_upto(0), analyses(0) {
+        if (step <= 0. || horizon < step) {
+            throw std::invalid_argument("Invalid grid.");
+        }
+    }
+
+    virtual ~TaskSet() = default;
+
+    /**
+     * @brief Add a task to the set
+     * @param id        The task identifier
+     * @param wcet      The pWCET distribution of the task
+     * @param period    The task period
+     * @param priority  The task priority (unique, higher value means higher priority)
+     * @param deadline  The task relative deadline, not greater than the period. If zero, the
+     *                  deadline is the period.
+     */
+    void add_task(int id, std::shared_ptr<ResponseEVTDistribution> wcet, double period,
+                  int priority, double deadline = 0.) {
+        if (deadline == 0.) {
+            deadline = period;
+        }
+        if (period <= 0. || deadline <= 0. || deadline > period || deadline > horizon()) {
+            throw std::invalid_argument("Invalid period or deadline.");
+        }
+        for (const auto &t : this->tasks) {
+            if (t.id == id || t.priority == priority) {
+                throw std::invalid_argument("Duplicated task identifier or priority.");
+            }
+        }
+
+        Task task(id, priority, period, deadline, std::move(wcet));
+        task.exec = std::make_shared<DiscreteDistribution>(discretize(*task.wcet));
+
+        auto pos = std::find_if(this->tasks.begin(), this->tasks.end(),
+                                [priority](const Task &t) { return t.priority < priority; });
+        const size_t idx = pos - this->tasks.begin();
+        this->tasks.insert(pos, std::move(task));
+        invalidate_from(idx);
+    }
+
+    /** @brief Remove a task from the set */
+    void remove_task(int id) {
+        const size_t idx = find(id);
+        this->tasks.erase(this->tasks.begin() + idx);
+        invalidate_from(idx);
+    }
+
+    /** @brief Getter for the number of tasks */
+    inline size_t size() const noexcept {
+        return this->tasks.size();
+    }
+
+    /** @brief Getter for the grid horizon */
+    inline double horizon() const noexcept {
+        return (this->bins - 1) * this->step;
+    }
+
+    /**
+     * @brief The response time distribution of the task. The distribution is truncated at the
+     *        horizon: the remaining mass is reported as overflow.
+     */
+    const DiscreteDistribution &get_response_time(int id) {
+        const size_t idx = find(id);
+        update(idx);
+        return *this->tasks[idx].response;
+    }
+
+    /** @brief The probability that a job of the task misses its deadline */
+    double get_deadline_miss_probability(int id) {
+        const size_t idx = find(id);
+        update(idx);
+        const Task &task = this->tasks[idx];
+        return task.response->get_exceedance(task.deadline);
+    }
+
+    /** @brief True if no task misses its deadline with probability greater than the given one */
+    bool is_schedulable(double max_miss_probability) {
+        for (size_t i = 0; i < this->tasks.size(); i++) {
+            if (get_deadline_miss_probability(this->tasks[i].id) > max_miss_probability) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /** @brief Getter for the number of response time analyses performed so far */
+    inline size_t get_analysis_count() const noexcept {
+        return this->analyses;
+    }
+
+private:
+
+    struct Task {
+        int id;
+        int priority;
+        double period;
+        double deadline;
+        std::shared_ptr<ResponseEVTDistribution> wcet;
+        std::shared_ptr<DiscreteDistribution> exec;      /*!< Discretized execution time */
+        std::shared_ptr<DiscreteDistribution> prefix;    /*!< Sum of the higher priority ones */
+        std::shared_ptr<DiscreteDistribution> response;  /*!< Response time */
+
+        Task(int id, int priority, double period, double deadline,
+             std::shared_ptr<ResponseEVTDistribution> wcet)
+            : id(id), priority(priority), period(period), deadline(deadline),
+              wcet(std::move(wcet)) {}
+    };
+
+    const double step;
+    const size_t bins;
+    const double max_overflow;
+
+    std::vector<Task> tasks;    /*!< Sorted by decreasing priority */
+    size_t valid_upto;          /*!< The caches of tasks[0 ... valid_upto-1] are valid */
+    size_t analyses;
+
+    size_t find(int id) const {
+        for (size_t i = 0; i < this->tasks.size(); i++) {
+            if (this->tasks[i].id == id) {
+                return i;
+            }
+        }
+        throw std::invalid_argument("Unknown task.");
+    }
+
+    DiscreteDistribution discretize(const ResponseEVTDistribution &dist) const {
+        DiscreteDistribution d = DiscreteDistribution::from_evt(dist, this->step, this->max_overflow);
+        if (d.get_bins() <= this->bins) {
+            return d;
+        }
+        // Values beyond the horizon are deadline misses anyway
+        std::vector<double> pmf(d.get_pmf().cbegin(), d.get_pmf().cbegin() + this->bins);
+        const double overflow = d.get_overflow()
+                              + std::accumulate(d.get_pmf().cbegin() + this->bins, d.get_pmf().cend(), 0.);
+        return DiscreteDistribution(this->step, std::move(pmf), std::min(overflow, 1.));
+    }
+
+    void invalidate_from(size_t idx) noexcept {
+        this->valid_upto = std::min(this->valid_upto, idx);
+        for (size_t i = idx; i < this->tasks.size(); i++) {
+            this->tasks[i].prefix.reset();
+            this->tasks[i].response.reset();
+        }
+    }
+
+    void update(size_t idx) {
+        for (size_t i = this->valid_upto; i <= idx; i++) {
+            Task &task = this->tasks[i];
+            if (i == 0) {
+                task.prefix = std::make_shared<DiscreteDistribution>(this->step,
+                                                                     std::vector<double>(1, 1.), 0.);
+            } else {
+                const Task &prev = this->tasks[i-1];
+                task.prefix = std::make_shared<DiscreteDistribution>(
+                                        convolve(*prev.prefix, *prev.exec, this->bins));
+            }
+            task.response = std::make_shared<DiscreteDistribution>(response_time(i));
+        }
+        this->valid_upto = std::max(this->valid_upto, idx + 1);
+    }
+
+    DiscreteDistribution response_time(size_t idx) {
+        const Task &task = this->tasks[idx];
+        this->analyses++;
+
+        // Critical instant: all the higher priority tasks are released with the task
+        DiscreteDistribution backlog = convolve(*task.prefix, *task.exec, this->bins);
+        std::vector<double> pmf = backlog.get_pmf();
+        pmf.resize(this->bins, 0.);
+        double overflow = backlog.get_overflow();
+
+        // The following releases of higher priority jobs within the deadline, in time order
+        std::vector<std::pair<double, size_t>> releases;
+        for (size_t j = 0; j < idx; j++) {
+            for (double t = this->tasks[j].period; t < task.deadline; t += this->tasks[j].period) {
+                releases.emplace_back(t, j);
+            }
+        }
+        std::sort(releases.begin(), releases.end());
+
+        for (const auto &rel : releases) {
+            // Jobs completed at or before the release are not preempted. The mass of the grid
+            // point x_k comes from (x_{k-1}, x_k], so only points up to floor(t/step) are done.
+            const size_t split = static_cast<size_t>(std::floor(rel.first / this->step)) + 1;
+            if (split >= this->bins) {
+                break;
+            }
+
+            std::vector<double> running(pmf.cbegin() + split, pmf.cend());
+            const double running_mass = std::accumulate(running.cbegin(), running.cend(), 0.);
+            if (running_mass <= 0.) {
+                continue;
+            }
+
+            const DiscreteDistribution &preempt = *this->tasks[rel.second].exec;
+            const std::vector<double> delayed = convolution::convolve(running, preempt.get_pmf());
+
+            std::fill(pmf.begin() + split, pmf.end(), 0.);
+            for (size_t k = 0; k < delayed.size(); k++) {
+                if (split + k < this->bins) {
+                    pmf[split + k] += delayed[k];
+                } else {
+                    overflow += delayed[k];
+                }
+            }
+            overflow += running_mass * preempt.get_overflow();
+        }
+
+        return DiscreteDistribution(this->step, std::move(pmf), std::min(overflow, 1.));
+    }
+};
+
+}    // libta
+
+#endif // LIBTA_SCHED_H_
@@ -0,0 +1,274 @@
+/** @file libta_service.h
+ * A local analysis service fed through shared memory.
+ *
+ * Instead of linking an analyzer in every application, a single service process owns one
+ * TimingAnalyzer and one shared memory ring per task (see libta_shm.h). The applications only
+ * push their samples with a SampleProducer. The service periodically drains all the rings,
+ * re-estimates the tasks that collected enough new samples and publishes the results, e.g. in a
+ * DistributionRegistry readable by other processes (see libta_registry.h).
+ *
+ * @copyright
+ * Copyright 2020 Politecnico di Milano
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef LIBTA_SERVICE_H_
+#define LIBTA_SERVICE_H_
+
+#include "libta.h"
+#include "libta_registry.h"
+#include "libta_shm.h"
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace libta {
+
+/**
+ * @brief The analysis service
+ *
+ * The tasks must be added, removed and inspected (get_samples(), get_dropped(),
+ * get_corruptions(), get_unpublished()) by the thread running poll_once() (or run()); only the results can be read
+ * from any thread. Every poll drains at most one ring capacity per task, so the analyses keep
+ * running even when a producer is as fast as the service.
+ */
+template <typename T>
+class AnalysisService {
+
+public:
+
+    /** @brief Called with the task identifier and the new result after every analysis */
+    typedef std::function<void(int, std::shared_ptr<Response>)> publisher_t;
+
+    /**
+     * @brief The AnalysisService class constructor
+     * @param analyzer      The analyzer shared by all the tasks
+     * @param batch_samples The number of new samples that triggers a re-estimation of a task
+     * @param max_samples   Only the most recent max_samples samples of every task are kept and
+     *                      analyzed. If zero the traces grow without limit, and every analysis
+     *                      is performed on the whole history.
+     */
+    AnalysisService(std::shared_ptr<TimingAnalyzer<T>> analyzer, size_t batch_samples = 1000,
+                    size_t max_samples = DEFAULT_MAX_SAMPLES)
+        : analyzer(std::move(analyzer)), batch_samples(batch_samples), max_samples(max_samples),
+          staging(STAGING_SIZE) {
+
+    }
+
+    virtual ~AnalysisService() = default;
+
+    /**
+     * @brief Create the ring of a new task
+     * @param id        The task identifier
+     * @param name      The name of the shared memory object, e.g. "/libta.task0"
+     * @param capacity  The number of samples of the ring, a power of 2
+     */
+    void add_task(int id, const std::string &name, uint64_t capacity) {
+        if (this->tasks.count(id) != 0) {
+            throw std::invalid_argument("Duplicated task identifier.");
+        }
+        this->tasks.emplace(id, Task(name, capacity));
+    }
+
+    /** @brief Remove a task and its ring */
+    void remove_task(int id) {
+        this->tasks.erase(id);
+        std::lock_guard<std::mutex> lock(this->results_mutex);
+        this->results.erase(id);
+    }
+
+    /** @brief Set the function called after every analysis */
+    void set_publisher(publisher_t publisher) {
+        this->publisher = std::move(publisher);
+    }
+
+    /**
+     * @brief Publish every estimated distribution in the given registry, which must have been
+     *        created by this process. Pass nullptr to stop publishing.
+     */
+    void set_registry(std::shared_ptr<DistributionRegistry> registry) noexcept {
+        this->registry = std::move(registry);
+    }
+
+    /**
+     * @brief Drain all the rings and analyze the tasks with at least batch_samples new samples
+     * @return The number of analyses performed
+     */
+    size_t poll_once() {
+        // Drain everything first, so the rings are emptied as soon as possible
+        for (auto &it : this->tasks) {
+            drain(it.second);
+        }
+
+        size_t analyses = 0;
+        for (auto &it : this->tasks) {
+            Task &task = it.second;
+            if (task.new_samples < this->batch_samples) {
+                continue;
+            }
+            task.new_samples = 0;
+
+            std::shared_ptr<Response> result;
+            try {
+                result = this->analyzer->perform_analysis(task.trace);
+            } catch (const TimingAnalyzerError &) {
+                // Not enough information yet: retry with the next batch
+                continue;
+            }
+            analyses++;
+
+            {
+                std::lock_guard<std::mutex> lock(this->results_mutex);
+                this->results[it.first] = result;
+            }
+            if (this->registry
+                && result->get_response_type() == response_type_t::PWCET_DISTRIBUTION
+                && ! this->registry->publish(it.first,
+                                             *std::static_pointer_cast<ResponseEVTDistribution>(result))) {
+                // The registry is full: the readers keep missing this task
+                task.unpublished++;
+            }
+            if (this->publisher) {
+                this->publisher(it.first, result);
+            }
+        }
+        return analyses;
+    }
+
+    /** @brief Call poll_once() every period until stop is cancelled */
+    void run(const CancellationToken &stop, std::chrono::microseconds period) {
+        while (! stop.is_cancelled()) {
+            const auto next = std::chrono::steady_clock::now() + period;
+            poll_once();
+            std::this_thread::sleep_until(next);
+        }
+    }
+
+    /** @brief The last result of a task, nullptr if not analyzed yet */
+    std::shared_ptr<Response> get_result(int id) const {
+        std::lock_guard<std::mutex> lock(this->results_mutex);
+        auto it = this->results.find(id);
+        return it == this->results.end() ? nullptr : it->second;
+    }
+
+    /** @brief The number of samples of a task currently analyzed. Polling thread only. */
+    size_t get_samples(int id) const {
+        return get_task(id).trace->size();
+    }
+
+    /**
+     * @brief The number of samples of a task dropped because its ring was full. Polling thread
+     *        only.
+     */
+    uint64_t get_dropped(int id) const {
+        return get_task(id).ring.get_dropped();
+    }
+
+    /**
+     * @brief The number of times the ring of a task was found corrupted by its producer.
+     *        Polling thread only.
+     */
+    uint64_t get_corruptions(int id) const {
+        return get_task(id).ring.get_corruptions();
+    }
+
+    /**
+     * @brief The number of results of a task that could not be published because the registry
+     *        was full. Polling thread only.
+     */
+    uint64_t get_unpublished(int id) const {
+        return get_task(id).unpublished;
+    }
+
+    /** @brief The default number of most recent samples analyzed per task */
+    static constexpr size_t DEFAULT_MAX_SAMPLES = 100000;
+
+private:
+    static constexpr size_t STAGING_SIZE = 4096;
+
+    struct Task {
+        SampleConsumer<T> ring;
+        std::shared_ptr<Request<T>> trace;
+        size_t new_samples;
+        uint64_t unpublished;
+
+        Task(const std::string &name, uint64_t capacity)
+            : ring(name, capacity), trace(std::make_shared<Request<T>>()), new_samples(0),
+              unpublished(0) {}
+    };
+
+    const std::shared_ptr<TimingAnalyzer<T>> analyzer;
+    const size_t batch_samples;
+    const size_t max_samples;
+
+    std::map<int, Task> tasks;
+    std::vector<T> staging;
+    publisher_t publisher;
+    std::shared_ptr<DistributionRegistry> registry;
+
+    mutable std::mutex results_mutex;
+    std::map<int, std::shared_ptr<Response>> results;
+
+    const Task &get_task(int id) const {
+        auto it = this->tasks.find(id);
+        if (it == this->tasks.end()) {
+            throw std::invalid_argument("Unknown task.");
+        }
+        return it->second;
+    }
+
+    void drain(Task &task) {
+        // At most one ring capacity per poll: a producer as fast as the service cannot keep it
+        // draining forever, without analyzing and publishing
+        uint64_t budget = task.ring.get_capacity();
+        size_t count;
+        while (budget > 0
+               && (count = task.ring.pop(this->staging.data(),
+                                         std::min<uint64_t>(this->staging.size(), budget))) > 0) {
+            budget -= count;
+            task.trace->add_values(this->staging.data(), count);
+            task.new_samples += count;
+
+            // Trim as soon as the trace doubles its limit, so it stays bounded while draining
+            if (this->max_samples != 0 && task.trace->size() >= 2 * this->max_samples) {
+                trim(task);
+            }
+        }
+
+        if (this->max_samples != 0 && task.trace->size() > this->max_samples) {
+            trim(task);
+        }
+    }
+
+    void trim(Task &task) {
+        task.trace->discard_oldest(task.trace->size() - this->max_samples);
+    }
+};
+
+template <typename T>
+constexpr size_t AnalysisService<T>::STAGING_SIZE;
+
+template <typename T>
+constexpr size_t AnalysisService<T>::DEFAULT_MAX_SAMPLES;
+
+}    // libta
+
+#endif // LIBTA_SERVICE_H_
@@ -0,0 +1,333 @@
+/** @file libta_shm.h
+ * Lock-free ring buffers of execution times in POSIX shared memory.
+ *
+ * Every monitored task has its own single-producer single-consumer ring buffer, living in a
+ * POSIX shared memory object. The application measuring the task pushes the samples with
+ * SampleProducer::push(), which is a couple of loads and stores on memory already mapped: no
+ * syscall and no lock is ever involved. The analysis service (see libta_service.h) drains the
+ * rings from a different process.
+ *
+ * The head and the tail indexes are free-running 64-bit counters, placed on different cache
+ * lines, so that the producer and the consumer do not invalidate each other's lines at every
+ * sample. When the ring is full the sample is dropped and counted, the producer never blocks.
+ *
+ * @note Only for POSIX systems. With glibc older than 2.34, link with -lrt.
+ *
+ * @copyright
+ * Copyright 2020 Politecnico di Milano
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef LIBTA_SHM_H_
+#define LIBTA_SHM_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace libta {
+
+namespace shm {
+
+    static constexpr uint32_t RING_MAGIC   = 0x4c545242;   // "LTRB"
+    static constexpr uint32_t RING_VERSION = 1;
+    static constexpr size_t   CACHE_LINE   = 64;
+
+    /**
+     * @brief The header of a ring, at the beginning of the shared memory object. The samples
+     *        follow the header.
+     */
+    struct RingHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t sample_size;       /*!< sizeof(T), to detect mismatching producers */
+        uint32_t reserved;
+        uint64_t capacity;          /*!< Number of samples, a power of 2 */
+
+        alignas(CACHE_LINE) std::atomic<uint64_t> head;     /*!< Written by the producer only */
+        std::atomic<uint64_t> dropped;                      /*!< Samples lost because full */
+        alignas(CACHE_LINE) std::atomic<uint64_t> tail;     /*!< Written by the consumer only */
+    };
+
+    static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "Shared memory rings require lock-free 64-bit atomics");
+
+    inline size_t ring_size(size_t capacity, size_t sample_size) noexcept {
+        const size_t header = (sizeof(RingHeader) + CACHE_LINE - 1) / CACHE_LINE * CACHE_LINE;
+        return header + capacity * sample_size;
+    }
+
+    inline size_t data_offset() noexcept {
+        return ring_size(0, 0);
+    }
+
+    /**
+     * @brief Map a shared memory object
+     * @param name         The name of the object
+     * @param create_size  If not zero, create a new object of this size (zero-filled), failing if
+     *                     it already exists. Otherwise open an existing one.
+     * @param min_size     The minimum size of an existing object
+     * @param size         The size of the mapping
+     */
+    inline void *map_object(const std::string &name, size_t create_size, size_t min_size,
+                            size_t &size) {
+        const bool create = create_size != 0;
+        const int fd = shm_open(name.c_str(), create ? (O_RDWR | O_CREAT | O_EXCL) : O_RDWR, 0600);
+        if (fd < 0) {
+            throw std::runtime_error("Unable to open the shared memory object " + name + ": "
+                                     + std::strerror(errno));
+        }
+
+        if (create) {
+            size = create_size;
+            if (ftruncate(fd, size) != 0) {
+                close(fd);
+                shm_unlink(name.c_str());
+                throw std::runtime_error("Unable to size the shared memory object " + name);
+            }
+        } else {
+            struct stat st;
+            if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < min_size) {
+                close(fd);
+                throw std::runtime_error("Invalid shared memory object " + name);
+            }
+            size = st.st_size;
+        }
+
+        void *addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (addr == MAP_FAILED) {
+            if (create) {
+                shm_unlink(name.c_str());
+            }
+            throw std::runtime_error("Unable to map the shared memory object " + name);
+        }
+        return addr;
+    }
+
+}   // namespace shm
+
+/**
+ * @brief A mapping of a shared memory ring, base of the producer and consumer endpoints
+ */
+template <typename T>
+class SampleRing {
+
+    static_assert(std::is_trivially_copyable<T>::value, "Samples must be trivially copyable");
+
+public:
+
+    SampleRing(const SampleRing &) = delete;
+    SampleRing &operator=(const SampleRing &) = delete;
+
+    SampleRing(SampleRing &&other) noexcept
+        : header(other.header), data(other.data), mask(other.mask), size(other.size) {
+        other.header = nullptr;
+    }
+
+    virtual ~SampleRing() {
+        if (this->header != nullptr) {
+            munmap(this->header, this->size);
+        }
+    }
+
+    /** @brief Getter for the capacity of the ring, in samples */
+    inline uint64_t get_capacity() const noexcept {
+        return this->mask + 1;
+    }
+
+    /** @brief Getter for the number of samples lost because the ring was full */
+    inline uint64_t get_dropped() const noexcept {
+        return this->header->dropped.load(std::memory_order_relaxed);
+    }
+
+    /** @brief Number of samples pushed and not consumed yet */
+    inline uint64_t get_pending() const noexcept {
+        return this->header->head.load(std::memory_order_acquire)
+               - this->header->tail.load(std::memory_order_acquire);
+    }
+
+    /** @brief Remove the shared memory object. Existing mappings stay valid. */
+    static void unlink(const std::string &name) noexcept {
+        shm_unlink(name.c_str());
+    }
+
+protected:
+    shm::RingHeader *header;
+    T *data;
+    uint64_t mask;
+    size_t size;
+
+    /**
+     * @brief Map an existing ring or, if capacity is not zero, create a new one
+     * @param name  The name of the shared memory object, e.g. "/libta.task0"
+     */
+    SampleRing(const std::string &name, uint64_t capacity) : header(nullptr) {
+        const bool create = capacity != 0;
+        if (create && (capacity & (capacity - 1)) != 0) {
+            throw std::invalid_argument("The ring capacity must be a power of 2.");
+        }
+
+        void *addr = shm::map_object(name, create ? shm::ring_size(capacity, sizeof(T)) : 0,
+                                     shm::data_offset(), this->size);
+        this->header = static_cast<shm::RingHeader*>(addr);
+        this->data = reinterpret_cast<T*>(static_cast<char*>(addr) + shm::data_offset());
+
+        if (create) {
+            // The object is zero-filled by ftruncate()
+            new (&this->header->head) std::atomic<uint64_t>(0);
+            new (&this->header->dropped) std::atomic<uint64_t>(0);
+            new (&this->header->tail) std::atomic<uint64_t>(0);
+            this->header->capacity = capacity;
+            this->header->sample_size = sizeof(T);
+            this->header->version = shm::RING_VERSION;
+            std::atomic_thread_fence(std::memory_order_release);
+            this->header->magic = shm::RING_MAGIC;
+        } else if (this->header->magic != shm::RING_MAGIC
+                   || this->header->version != shm::RING_VERSION
+                   || this->header->sample_size != sizeof(T)
+                   || shm::ring_size(this->header->capacity, sizeof(T)) > this->size) {
+            munmap(addr, this->size);
+            this->header = nullptr;
+            throw std::runtime_error("Incompatible shared memory ring " + name);
+        }
+
+        this->mask = this->header->capacity - 1;
+    }
+};
+
+/**
+ * @brief The application side of a ring: it pushes the samples
+ *
+ * There must be a single producer per ring. Multi-threaded applications use one ring per thread.
+ */
+template <typename T>
+class SampleProducer : public SampleRing<T> {
+
+public:
+
+    /** @brief Attach to the ring created by the analysis service */
+    explicit SampleProducer(const std::string &name) : SampleRing<T>(name, 0) {}
+
+    /**
+     * @brief Push a sample. Wait-free, no syscall.
+     * @return false if the ring is full: the sample is dropped
+     */
+    inline bool push(const T &value) noexcept {
+        shm::RingHeader *h = this->header;
+        const uint64_t head = h->head.load(std::memory_order_relaxed);
+        if (head - h->tail.load(std::memory_order_acquire) > this->mask) {
+            h->dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        this->data[head & this->mask] = value;
+        h->head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+};
+
+/**
+ * @brief The service side of a ring: it creates the ring and drains the samples
+ */
+template <typename T>
+class SampleConsumer : public SampleRing<T> {
+
+public:
+
+    /**
+     * @brief Create a new ring. Fails if a shared memory object with the same name exists.
+     * @param capacity  The number of samples, a power of 2
+     */
+    SampleConsumer(const std::string &name, uint64_t capacity)
+        : SampleRing<T>(name, check_capacity(capacity)), name(name), tail(0), corruptions(0) {}
+
+    SampleConsumer(SampleConsumer &&) = default;
+
+    /** @brief The consumer owns the ring: the shared memory object is removed */
+    virtual ~SampleConsumer() {
+        if (this->header != nullptr) {
+            SampleRing<T>::unlink(this->name);
+        }
+    }
+
+    /** @brief Getter for the name of the shared memory object */
+    inline const std::string &get_name() const noexcept {
+        return this->name;
+    }
+
+    /**
+     * @brief Getter for the number of times the ring was found corrupted, i.e. with more pending
+     *        samples than its capacity. The pending samples are discarded every time.
+     */
+    inline uint64_t get_corruptions() const noexcept {
+        return this->corruptions;
+    }
+
+    /**
+     * @brief Move up to max samples to out
+     *
+     * The mapping is writable by the producer, so its indexes are not trusted: the tail is kept
+     * by the consumer, and a head more than one capacity ahead of it is treated as a corruption.
+     *
+     * @return The number of samples copied
+     */
+    size_t pop(T *out, size_t max) noexcept {
+        shm::RingHeader *h = this->header;
+        const uint64_t tail = this->tail;
+        const uint64_t head = h->head.load(std::memory_order_acquire);
+        const uint64_t available = head - tail;
+        if (available > this->mask + 1) {
+            this->corruptions++;
+            this->tail = head;
+            h->tail.store(head, std::memory_order_release);
+            return 0;
+        }
+        const size_t count = static_cast<size_t>(std::min<uint64_t>(available, max));
+
+        // At most two contiguous chunks
+        const size_t first = std::min<size_t>(count, this->mask + 1 - (tail & this->mask));
+        std::memcpy(out, this->data + (tail & this->mask), first * sizeof(T));
+        std::memcpy(out + first, this->data, (count - first) * sizeof(T));
+
+        this->tail = tail + count;
+        h->tail.store(this->tail, std::memory_order_release);
+        return count;
+    }
+
+private:
+    std::string name;
+    uint64_t tail;          /*!< The trusted copy of header->tail */
+    uint64_t corruptions;
+
+    static uint64_t check_capacity(uint64_t capacity) {
+        if (capacity == 0) {
+            throw std::invalid_argument("The ring capacity must be a power of 2.");
+        }
+        return capacity;
+    }
+};
+
+}    // libta
+
+#endif // LIBTA_SHM_H_
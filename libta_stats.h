@@ -0,0 +1,128 @@
+/** @file libta_stats.h
+ * Per-phase instrumentation of the analyzers.
+ *
+ * Analyzers record, for every analysis, the wall time spent in each phase, the bytes of memory
+ * allocated, the number of samples and the number of tail samples selected. The statistics of the
+ * last analysis are returned together with the result, and they are also accumulated in a
+ * thread-local registry, so no synchronization is ever needed.
+ *
+ * The time measurement is enabled by building the library with LIBTA_STATS defined (see the
+ * CMake option with the same name). When it is not defined the times are left to zero. The
+ * phases are measured inside the library only, so this header does not depend on the macro and
+ * the users can include it with or without it.
+ *
+ * Building the library with LIBTA_PERF too, each phase is measured with the hardware performance
+ * counters (see libta_perf.h). Where the counters are not available they are left to zero and
+ * the analyses are not accounted in AnalysisStats::counted.
+ *
+ * @copyright
+ * Copyright 2020 Politecnico di Milano
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef LIBTA_STATS_H_
+#define LIBTA_STATS_H_
+
+#include "libta_perf.h"
+
+#include <cstdint>
+
+namespace libta {
+
+/**
+ * @brief The phases of an analysis
+ */
+typedef enum class phase_e {
+    COPY,           /*!< Copy of the trace */
+    SORT,           /*!< Sort (or selection) of the trace */
+    CV_SCAN,        /*!< Threshold selection */
+    GRID,           /*!< Tail fit and generation of the survival function grid */
+    RESPONSE,       /*!< Allocation of the response objects */
+    COUNT           /*!< Number of phases, not a phase */
+} phase_t;
+
+/**
+ * @brief The statistics of one or more analyses
+ */
+struct AnalysisStats {
+
+    static constexpr int PHASES = static_cast<int>(phase_t::COUNT);
+
+    uint64_t analyses = 0;              /*!< Number of analyses accounted */
+    uint64_t time_ns[PHASES] = {};      /*!< Wall time of each phase (only with LIBTA_STATS) */
+    uint64_t bytes_allocated = 0;       /*!< Bytes of heap memory allocated */
+    uint64_t samples = 0;               /*!< Number of samples analyzed */
+    uint64_t nelems = 0;                /*!< Number of tail samples selected */
+    uint64_t counted = 0;               /*!< Number of analyses measured by the hardware counters */
+    uint64_t counters[PHASES][PerfCounters::COUNTERS] = {};  /*!< Hardware counters of each phase */
+
+    /** @brief Getter for the wall time of a phase, in nanoseconds */
+    inline uint64_t get_time_ns(phase_t phase) const noexcept {
+        return this->time_ns[static_cast<int>(phase)];
+    }
+
+    /** @brief Getter for the total wall time, in nanoseconds */
+    inline uint64_t get_total_time_ns() const noexcept {
+        uint64_t total = 0;
+        for (int i = 0; i < PHASES; i++) {
+            total += this->time_ns[i];
+        }
+        return total;
+    }
+
+    /** @brief Getter for a hardware counter of a phase */
+    inline uint64_t get_counter(phase_t phase, counter_t counter) const noexcept {
+        return this->counters[static_cast<int>(phase)][static_cast<int>(counter)];
+    }
+
+    /** @brief Getter for a hardware counter summed over all the phases */
+    inline uint64_t get_total_counter(counter_t counter) const noexcept {
+        uint64_t total = 0;
+        for (int i = 0; i < PHASES; i++) {
+            total += this->counters[i][static_cast<int>(counter)];
+        }
+        return total;
+    }
+
+    inline void reset() noexcept {
+        *this = AnalysisStats();
+    }
+
+    AnalysisStats &operator+=(const AnalysisStats &other) noexcept {
+        this->analyses += other.analyses;
+        for (int i = 0; i < PHASES; i++) {
+            this->time_ns[i] += other.time_ns[i];
+            for (int j = 0; j < PerfCounters::COUNTERS; j++) {
+                this->counters[i][j] += other.counters[i][j];
+            }
+        }
+        this->bytes_allocated += other.bytes_allocated;
+        this->samples += other.samples;
+        this->nelems += other.nelems;
+        this->counted += other.counted;
+        return *this;
+    }
+};
+
+/**
+ * @brief The statistics accumulated by all the analyses performed by the calling thread
+ */
+inline AnalysisStats &thread_stats() noexcept {
+    static thread_local AnalysisStats stats;
+    return stats;
+}
+
+}    // libta
+
+#endif // LIBTA_STATS_H_
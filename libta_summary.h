@@ -0,0 +1,309 @@
+/** @file libta_summary.h
+ * Mergeable summaries of the tail of execution time traces.
+ *
+ * The tail estimate depends only on the largest samples of a trace. A TailSummary keeps the top-k
+ * samples exactly and only the count, the mean and the variance of all the others (the body).
+ * Summaries built independently (per core, per process, per node) can be merged in O(k), in any
+ * order and grouping, and sent over the network as a compact byte string, instead of shipping
+ * every sample to a single place.
+ *
+ * @copyright
+ * Copyright 2020 Politecnico di Milano
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ */
+#ifndef LIBTA_SUMMARY_H_
+#define LIBTA_SUMMARY_H_
+
+#include "libta.h"
+#include "libta_cache.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <type_traits>
+#include <vector>
+
+namespace libta {
+
+/**
+ * @brief The top-k samples of a trace plus the moments of the remaining ones
+ *
+ * The top samples are kept in a min-heap, so adding a sample costs O(log k). The moments of the
+ * body are updated with Welford's algorithm and merged with the parallel formula of Chan et al.,
+ * so that merging does not lose precision.
+ *
+ * The merged top-k is exactly the top-k of the union of the traces, so any analysis depending
+ * only on the top samples (e.g. BSCTimingAnalyzer) gives the same result on the merged summary
+ * and on the whole trace, as long as k is large enough.
+ */
+template <typename T>
+class TailSummary {
+
+public:
+
+    /** @brief The largest number of top samples a summary can keep */
+    static constexpr size_t MAX_K = size_t(1) << 30;
+
+    /**
+     * @brief The TailSummary class constructor
+     * @param k  The number of top samples kept, at most MAX_K
+     */
+    explicit TailSummary(size_t k) : TailSummary(k, k) {}
+
+    virtual ~TailSummary() = default;
+
+    /** @brief Add a sample */
+    void add_value(const T &value) {
+        if (this->top.size() < this->k) {
+            this->top.push_back(value);
+            std::push_heap(this->top.begin(), this->top.end(), std::greater<T>());
+        } else if (value > this->top.front()) {
+            std::pop_heap(this->top.begin(), this->top.end(), std::greater<T>());
+            add_body(this->top.back());
+            this->top.back() = value;
+            std::push_heap(this->top.begin(), this->top.end(), std::greater<T>());
+        } else {
+            add_body(value);
+        }
+    }
+
+    /** @brief Add the values of an iterator range */
+    template <typename InputIt>
+    void add_values(InputIt first, InputIt last) {
+        for (; first != last; ++first) {
+            add_value(*first);
+        }
+    }
+
+    /** @brief Add all the values of a request */
+    inline void add_values(const Request<T> &req) {
+        add_values(req.cbegin(), req.cend());
+    }
+
+    /** @brief Merge another summary (with the same k) into this one */
+    TailSummary &merge(const TailSummary &other) {
+        if (other.k != this->k) {
+            throw std::invalid_argument("Only summaries with the same k can be merged.");
+        }
+        if (&other == this) {
+            const TailSummary copy(other);
+            return merge(copy);
+        }
+
+        // Chan et al. parallel update of the body moments
+        if (other.body_count > 0) {
+            const uint64_t n = this->body_count + other.body_count;
+            const double d = other.body_mean - this->body_mean;
+            this->body_mean += d * other.body_count / n;
+            this->body_m2 += other.body_m2
+                           + d * d * (static_cast<double>(this->body_count) * other.body_count / n);
+            this->body_count = n;
+        }
+
+        for (const auto &v : other.top) {
+            add_value(v);
+        }
+        return *this;
+    }
+
+    /** @brief Getter for k */
+    inline size_t get_k() const noexcept {
+        return this->k;
+    }
+
+    /** @brief Getter for the total number of samples summarized */
+    inline uint64_t get_count() const noexcept {
+        return this->top.size() + this->body_count;
+    }
+
+    /** @brief Getter for the number of samples kept exactly */
+    inline size_t get_top_size() const noexcept {
+        return this->top.size();
+    }
+
+    /** @brief Getter for the number of samples of the body */
+    inline uint64_t get_body_count() const noexcept {
+        return this->body_count;
+    }
+
+    /** @brief Getter for the mean of the body */
+    inline double get_body_mean() const noexcept {
+        return this->body_mean;
+    }
+
+    /** @brief Getter for the unbiased variance of the body */
+    inline double get_body_variance() const noexcept {
+        return this->body_count > 1 ? this->body_m2 / (this->body_count - 1) : 0.;
+    }
+
+    /** @brief Copy the top samples into out, sorted in decreasing order */
+    void get_top(std::vector<T> &out) const {
+        out.assign(this->top.cbegin(), this->top.cend());
+        std::sort(out.begin(), out.end(), std::greater<T>());
+    }
+
+    /** @brief The number of bytes written by serialize() */
+    inline size_t serialized_size() const noexcept {
+        return HEADER_SIZE + 8 * this->top.size();
+    }
+
+    /**
+     * @brief Serialize the summary into buf, which must be at least serialized_size() bytes long
+     *
+     * | offset | size | content                                |
+     * |--------|------|----------------------------------------|
+     * | 0      | 4    | magic "LTTS"                           |
+     * | 4      | 1    | format version                         |
+     * | 5      | 1    | sample encoding: 'f', 'i' or 'u'       |
+     * | 6      | 2    | reserved (zero)                        |
+     * | 8      | 8    | k                                      |
+     * | 16     | 8    | number of body samples                 |
+     * | 24     | 8    | body mean                              |
+     * | 32     | 8    | body sum of squared deviations         |
+     * | 40     | 8    | number of top samples (t)              |
+     * | 48     | 8*t  | top samples                            |
+     *
+     * All the integers and doubles are stored little-endian. The samples of a floating point T
+     * are stored as doubles ('f'), those of an integer T as signed ('i') or unsigned ('u') 64-bit
+     * integers, so the round trip is exact. A long double does not fit and is rejected at compile
+     * time.
+     *
+     * @return The number of bytes written
+     */
+    size_t serialize(uint8_t *buf) const noexcept {
+        static_assert(std::is_integral<T>::value || sizeof(T) <= sizeof(double),
+                      "The samples must fit in a double or in a 64-bit integer.");
+        buf[0] = 'L'; buf[1] = 'T'; buf[2] = 'T'; buf[3] = 'S';
+        buf[4] = VERSION;
+        buf[5] = ENCODING;
+        buf[6] = buf[7] = 0;
+        serial::put_u64(buf + 8, this->k);
+        serial::put_u64(buf + 16, this->body_count);
+        serial::put_double(buf + 24, this->body_mean);
+        serial::put_double(buf + 32, this->body_m2);
+        serial::put_u64(buf + 40, this->top.size());
+        for (size_t i = 0; i < this->top.size(); i++) {
+            put_sample(buf + HEADER_SIZE + 8 * i, this->top[i], std::is_integral<T>());
+        }
+        return serialized_size();
+    }
+
+    /** @brief Serialize the summary into a new byte vector */
+    std::vector<uint8_t> serialize() const {
+        std::vector<uint8_t> buf(serialized_size());
+        serialize(buf.data());
+        return buf;
+    }
+
+    /**
+     * @brief Deserialize a summary previously produced by serialize()
+     * @return false if the buffer is truncated, corrupted, produced by an unknown format version
+     *         or by a summary of samples with a different encoding
+     */
+    static bool deserialize(const uint8_t *buf, size_t size, TailSummary &summary) {
+        static_assert(std::is_integral<T>::value || sizeof(T) <= sizeof(double),
+                      "The samples must fit in a double or in a 64-bit integer.");
+        if (size < HEADER_SIZE) {
+            return false;
+        }
+        if (buf[0] != 'L' || buf[1] != 'T' || buf[2] != 'T' || buf[3] != 'S' || buf[4] != VERSION
+            || buf[5] != ENCODING) {
+            return false;
+        }
+        // Both sizes are checked before any allocation, without overflowing
+        const uint64_t k = serial::get_u64(buf + 8);
+        const uint64_t top_size = serial::get_u64(buf + 40);
+        if (k == 0 || k > MAX_K || top_size > k || top_size > (size - HEADER_SIZE) / 8) {
+            return false;
+        }
+        // The body only holds the samples below a full top-k
+        const uint64_t body_count = serial::get_u64(buf + 16);
+        if (body_count > 0 && top_size < k) {
+            return false;
+        }
+
+        TailSummary result(k, top_size);
+        result.body_count = body_count;
+        result.body_mean = serial::get_double(buf + 24);
+        result.body_m2 = serial::get_double(buf + 32);
+        for (size_t i = 0; i < top_size; i++) {
+            result.top.push_back(get_sample(buf + HEADER_SIZE + 8 * i, std::is_integral<T>()));
+        }
+        std::make_heap(result.top.begin(), result.top.end(), std::greater<T>());
+
+        summary = std::move(result);
+        return true;
+    }
+
+private:
+    static constexpr uint8_t VERSION = 2;
+    static constexpr uint8_t ENCODING = ! std::is_integral<T>::value ? 'f'
+                                      : std::is_signed<T>::value ? 'i' : 'u';
+    static constexpr size_t HEADER_SIZE = 48;
+
+    static inline void put_sample(uint8_t *buf, const T &value, std::true_type) noexcept {
+        serial::put_u64(buf, static_cast<uint64_t>(value));
+    }
+
+    static inline void put_sample(uint8_t *buf, const T &value, std::false_type) noexcept {
+        serial::put_double(buf, static_cast<double>(value));
+    }
+
+    static inline T get_sample(const uint8_t *buf, std::true_type) noexcept {
+        return static_cast<T>(serial::get_u64(buf));
+    }
+
+    static inline T get_sample(const uint8_t *buf, std::false_type) noexcept {
+        return static_cast<T>(serial::get_double(buf));
+    }
+
+    TailSummary(size_t k, size_t reserve) : k(k) {
+        if (k == 0 || k > MAX_K) {
+            throw std::invalid_argument("The summary must keep between 1 and MAX_K samples.");
+        }
+        this->top.reserve(reserve);
+    }
+
+    size_t k;
+    std::vector<T> top;         /*!< Min-heap of the top samples */
+
+    uint64_t body_count = 0;
+    double body_mean = 0.;
+    double body_m2 = 0.;
+
+    inline void add_body(const T &value) noexcept {
+        const double x = static_cast<double>(value);
+        this->body_count++;
+        const double d = x - this->body_mean;
+        this->body_mean += d / this->body_count;
+        this->body_m2 += d * (x - this->body_mean);
+    }
+};
+
+template <typename T>
+constexpr uint8_t TailSummary<T>::VERSION;
+
+template <typename T>
+constexpr uint8_t TailSummary<T>::ENCODING;
+
+template <typename T>
+constexpr size_t TailSummary<T>::HEADER_SIZE;
+
+template <typename T>
+constexpr size_t TailSummary<T>::MAX_K;
+
+}    // libta
+
+#endif // LIBTA_SUMMARY_H_
@@ -1,12 +1,52 @@
 #include "gtest/gtest.h"
 
 #include "bscta/bscta.h"
+#include "libta_c.h"
+#include "libta_convolution.h"
+#include "libta_decimation.h"
+#include "libta_envelope.h"
+#include "libta_monitor.h"
+#include "libta_registry.h"
+#include "libta_sched.h"
+#include "libta_service.h"
+#include "libta_summary.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
 #include <iostream>
+#include <numeric>
 #include <random>
+#include <thread>
+
+#include <sys/wait.h>
+#include <unistd.h>
 
 #define GTEST_COUT std::cerr << "[          ] "
 
+// Count the heap allocations performed by the whole test program
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+static std::atomic<size_t> heap_allocations(0);
+
+void *operator new(size_t size) {
+	heap_allocations++;
+	void *ptr = std::malloc(size ? size : 1);
+	if (ptr == nullptr) {
+		throw std::bad_alloc();
+	}
+	return ptr;
+}
+
+void operator delete(void *ptr) noexcept {
+	std::free(ptr);
+}
+
+void operator delete(void *ptr, size_t) noexcept {
+	std::free(ptr);
+}
+
 
 
 TEST(distribution_test, test_distribution_normal)
@@ -93,3 +133,1343 @@ TEST(distribution_test, test_distribution_normal_low)
 	EXPECT_LE(pwcet->get_sigma(), pwcet2->get_sigma());
 
 }
+
+TEST(distribution_test, test_result_cache)
+{
+	const int n_estimation=500;  // number of experiments
+
+	std::default_random_engine generator;
+	std::normal_distribution<double> distribution(40,3.0);
+
+	std::shared_ptr<libta::Request<double>> req = std::make_shared<libta::Request<double>>();
+
+	for (int i=0; i<n_estimation; i++) {
+	    req->add_value(distribution(generator));
+	}
+
+	char dir_template[] = "/tmp/libta-cache-XXXXXX";
+	ASSERT_NE(mkdtemp(dir_template), nullptr);
+	auto cache = std::make_shared<libta::ResultCache>(dir_template);
+
+	libta::BSCTimingAnalyzer<double> mta;
+	mta.set_result_cache(cache);
+	auto pwcet = std::dynamic_pointer_cast<libta::ResponseEVTDistribution>(mta.perform_analysis(req));
+
+	libta::EVTRecord record;
+	const uint64_t key = libta::hash_request(*req, mta.get_configuration_hash());
+	ASSERT_TRUE(cache->load(key, record));
+	EXPECT_TRUE(record.has_bounds);
+	EXPECT_EQ(record.params, pwcet->get_parameters());
+
+	// A fresh analyzer must restore the result and the bounds from the cache
+	libta::BSCTimingAnalyzer<double> mta2;
+	mta2.set_result_cache(cache);
+	auto pwcet2 = std::dynamic_pointer_cast<libta::ResponseEVTDistribution>(mta2.perform_analysis(req));
+	EXPECT_EQ(pwcet->get_parameters(), pwcet2->get_parameters());
+	EXPECT_EQ(mta.get_high_wcet_at_p(0.999), mta2.get_high_wcet_at_p(0.999));
+	EXPECT_EQ(mta.get_low_wcet_at_p(0.999), mta2.get_low_wcet_at_p(0.999));
+
+	// A different configuration must not hit the same entry
+	libta::BSCTimingAnalyzer<double> mta3(1000);
+	EXPECT_NE(key, libta::hash_request(*req, mta3.get_configuration_hash()));
+
+	// Truncated or corrupted records are rejected
+	uint8_t buf[libta::serial::MAX_SIZE];
+	const size_t size = libta::serialize(record, buf);
+	EXPECT_EQ(size, libta::serial::MAX_SIZE);
+	EXPECT_FALSE(libta::deserialize(buf, size - 1, record));
+	buf[4] = 0xFF;
+	EXPECT_FALSE(libta::deserialize(buf, size, record));
+
+	// Concurrent writers of the same key never publish a partial entry
+	libta::EVTRecord other = record;
+	std::get<libta::ResponseEVTDistribution::P_MU>(other.params) += 1.;
+	std::atomic<bool> stop(false);
+	std::atomic<int> failed_stores(0), bad_loads(0);
+	std::vector<std::thread> writers;
+	for (int w=0; w<4; w++) {
+		writers.emplace_back([&, w]() {
+			for (int i=0; i<100; i++) {
+				if (! cache->store(key, w % 2 == 0 ? record : other)) {
+					failed_stores++;
+				}
+			}
+		});
+	}
+	std::thread reader([&]() {
+		libta::EVTRecord loaded;
+		while (! stop) {
+			if (cache->load(key, loaded) && loaded.params != record.params
+			    && loaded.params != other.params) {
+				bad_loads++;
+			}
+		}
+	});
+	for (auto &t : writers) {
+		t.join();
+	}
+	stop = true;
+	reader.join();
+	EXPECT_EQ(failed_stores, 0);
+	EXPECT_EQ(bad_loads, 0);
+	ASSERT_TRUE(cache->load(key, record));
+
+	cache->invalidate(key);
+	EXPECT_FALSE(cache->load(key, record));
+	EXPECT_EQ(rmdir(dir_template), 0);
+}
+
+TEST(distribution_test, test_async_analysis)
+{
+	const int n_estimation=500;  // number of experiments
+
+	std::default_random_engine generator;
+	std::normal_distribution<double> distribution(40,3.0);
+
+	std::shared_ptr<libta::Request<double>> req = std::make_shared<libta::Request<double>>();
+
+	for (int i=0; i<n_estimation; i++) {
+	    req->add_value(distribution(generator));
+	}
+
+	libta::BSCTimingAnalyzer<double> mta;
+	auto sync = std::dynamic_pointer_cast<libta::ResponseEVTDistribution>(mta.perform_analysis(req));
+
+	auto future = mta.perform_analysis_async(req);
+	auto async = std::dynamic_pointer_cast<libta::ResponseEVTDistribution>(future.get());
+	EXPECT_EQ(sync->get_parameters(), async->get_parameters());
+
+	// A cancelled analysis is abandoned
+	libta::CancellationToken token;
+	token.cancel();
+	auto cancelled = mta.perform_analysis_async(req, libta::AnalysisControl(token));
+	try {
+		cancelled.get();
+		FAIL() << "The cancelled analysis completed";
+	} catch(const libta::TimingAnalyzerError &e) {
+		EXPECT_EQ(e.get_type(), libta::error_t::CANCELLED);
+	}
+
+	// An analysis past its deadline is abandoned
+	libta::AnalysisControl expired(libta::CancellationToken(),
+	                               libta::AnalysisControl::clock_t::now() - std::chrono::seconds(1));
+	try {
+		mta.perform_analysis(req, expired);
+		FAIL() << "The expired analysis completed";
+	} catch(const libta::TimingAnalyzerError &e) {
+		EXPECT_EQ(e.get_type(), libta::error_t::DEADLINE_EXPIRED);
+	}
+
+	// Completion callback
+	std::promise<std::shared_ptr<libta::Response>> promise;
+	mta.perform_analysis_async(req, libta::AnalysisControl(),
+		[&promise](std::shared_ptr<libta::Response> resp, std::exception_ptr err) {
+			EXPECT_EQ(err, nullptr);
+			promise.set_value(resp);
+		});
+	auto callback = std::dynamic_pointer_cast<libta::ResponseEVTDistribution>(promise.get_future().get());
+	EXPECT_EQ(sync->get_parameters(), callback->get_parameters());
+
+	// Concurrent analyses never publish the low bound of one with the high bound of the other
+	std::shared_ptr<libta::Request<double>> shifted = std::make_shared<libta::Request<double>>();
+	for (double v : req->get_all()) {
+		shifted->add_value(v + 100);
+	}
+	libta::BSCTimingAnalyzer<double> shared(1000);
+	std::atomic<bool> stop(false);
+	std::atomic<int> torn(0);
+	shared.perform_analysis(req);
+	std::thread reader([&]() {
+		std::shared_ptr<libta::Response> low, high;
+		while (! stop) {
+			shared.get_bounds(low, high);
+			if (std::static_pointer_cast<libta::ResponseEVTDistribution>(low)->get_mu()
+			    != std::static_pointer_cast<libta::ResponseEVTDistribution>(high)->get_mu()) {
+				torn++;
+			}
+		}
+	});
+	std::thread writer([&]() {
+		for (int i=0; i<200; i++) {
+			shared.perform_analysis(shifted);
+		}
+	});
+	for (int i=0; i<200; i++) {
+		shared.perform_analysis(req);
+	}
+	writer.join();
+	stop = true;
+	reader.join();
+	EXPECT_EQ(torn.load(), 0);
+}
+
+TEST(distribution_test, test_anytime_analysis)
+{
+	const int n_estimation=20000;  // number of experiments
+
+	std::default_random_engine generator;
+	std::normal_distribution<double> distribution(40,3.0);
+
+	std::shared_ptr<libta::Request<double>> req = std::make_shared<libta::Request<double>>();
+
+	for (int i=0; i<n_estimation; i++) {
+	    req->add_value(distribution(generator));
+	}
+
+	libta::BSCTimingAnalyzer<double> mta;
+	auto full = std::dynamic_pointer_cast<libta::ResponseEVTDistribution>(mta.perform_analysis(req));
+	EXPECT_TRUE(full->is_complete());
+	EXPECT_EQ(full->get_used_samples(), (size_t)n_estimation);
+
+	// With a generous budget the anytime analysis converges to the full one
+	auto refined = mta.perform_anytime_analysis(req, std::chrono::seconds(60));
+	EXPECT_TRUE(refined->is_complete());
+	EXPECT_EQ(refined->get_parameters(), full->get_parameters());
+	EXPECT_LE(refined->get_used_samples(), (size_t)n_estimation);
+	EXPECT_EQ(refined->get_total_samples(), (size_t)n_estimation);
+
+	// With no budget at all an estimate is produced anyway, flagged if partial
+	auto quick = mta.perform_anytime_analysis(req, std::chrono::seconds(0));
+	EXPECT_LE(quick->get_used_samples(), refined->get_used_samples());
+	if (! quick->is_complete()) {
+		EXPECT_GE(quick->get_quantile(0.999), full->get_quantile(0.999));
+	}
+
+	// Incomplete estimates dominate the full one, and the upper bound of its confidence interval
+	for (unsigned seed : {1u, 2u, 3u}) {
+		std::mt19937 rng(seed);
+		std::normal_distribution<double> normal(1000, 25);
+		auto large = std::make_shared<libta::Request<double>>();
+		for (int i=0; i<20000; i++) {
+			large->add_value(normal(rng));
+		}
+
+		libta::BSCTimingAnalyzer<double> analyzer;
+		auto complete = std::dynamic_pointer_cast<libta::ResponseEVTDistribution>(analyzer.perform_analysis(large));
+		auto high = std::dynamic_pointer_cast<libta::ResponseEVTDistribution>(analyzer.get_high_gpd());
+		auto partial = analyzer.perform_anytime_analysis(large, std::chrono::seconds(0));
+		EXPECT_FALSE(partial->is_complete());
+		for (double p : {1e-3, 1e-6, 1e-9, 1e-12}) {
+			EXPECT_GE(partial->get_quantile(1 - p), complete->get_quantile(1 - p));
+			EXPECT_GE(partial->get_quantile(1 - p), high->get_quantile(1 - p));
+		}
+	}
+}
+
+TEST(distribution_test, test_workspace_no_allocation)
+{
+	const int n_estimation=2000;  // number of experiments
+
+	std::default_random_engine generator;
+	std::normal_distribution<double> distribution(40,3.0);
+
+	std::shared_ptr<libta::Request<double>> req = std::make_shared<libta::Request<double>>();
+
+	for (int i=0; i<n_estimation; i++) {
+	    req->add_value(distribution(generator));
+	}
+
+	libta::BSCTimingAnalyzer<double> mta;
+	auto pwcet = std::dynamic_pointer_cast<libta::ResponseEVTDistribution>(mta.perform_analysis(req));
+
+	// The first analysis sizes the workspace
+	libta::BSCWorkspace<double> ws;
+	mta.perform_analysis(*req, ws);
+	EXPECT_EQ(ws.get_result().get_parameters(), pwcet->get_parameters());
+
+	// Then, steady state analyses do not allocate
+	const size_t before = heap_allocations.load();
+	for (int i=0; i<3; i++) {
+		mta.perform_analysis(*req, ws);
+	}
+	EXPECT_EQ(heap_allocations.load(), before);
+
+	EXPECT_EQ(ws.get_result().get_parameters(), pwcet->get_parameters());
+	EXPECT_EQ(ws.get_high_gpd().get_parameters(),
+	          std::dynamic_pointer_cast<libta::ResponseEVTDistribution>(mta.get_high_gpd())->get_parameters());
+}
+
+TEST(distribution_test, test_value_result)
+{
+	const int n_estimation=2000;  // number of experiments
+
+	std::default_random_engine generator;
+	std::normal_distribution<double> distribution(40,3.0);
+
+	std::shared_ptr<libta::Request<double>> req = std::make_shared<libta::Request<double>>();
+
+	for (int i=0; i<n_estimation; i++) {
+	    req->add_value(distribution(generator));
+	}
+
+	libta::BSCTimingAnalyzer<double> mta;
+	auto pwcet = std::dynamic_pointer_cast<libta::ResponseEVTDistribution>(mta.perform_analysis(req));
+
+	libta::AnalysisResult<double> result = mta.analyze(*req);
+	ASSERT_TRUE(result.is_distribution());
+	EXPECT_EQ(result.get_dist_type(), pwcet->get_dist_type());
+	EXPECT_EQ(result.get_parameters(), pwcet->get_parameters());
+	EXPECT_EQ(result.get_quantile(0.999), pwcet->get_quantile(0.999));
+
+	// Steady state queries do not allocate
+	const size_t before = heap_allocations.load();
+	result = mta.analyze(*req);
+	EXPECT_EQ(heap_allocations.load(), before);
+
+	// The base class implementation goes through perform_analysis()
+	libta::AnalysisResult<double> generic = mta.libta::TimingAnalyzer<double>::analyze(*req);
+	EXPECT_EQ(generic.get_parameters(), result.get_parameters());
+
+	// Errors are returned, not thrown
+	libta::Request<double> small;
+	small.add_value(1.0);
+	result = mta.analyze(small);
+	ASSERT_TRUE(result.is_error());
+	EXPECT_EQ(result.get_error(), libta::error_t::INVALID_DATA);
+}
+
+TEST(distribution_test, test_bulk_request)
+{
+	const int n_estimation=2000;  // number of experiments
+
+	std::default_random_engine generator;
+	std::normal_distribution<double> distribution(40,3.0);
+
+	std::vector<double> samples;
+	for (int i=0; i<n_estimation; i++) {
+	    samples.push_back(distribution(generator));
+	}
+
+	std::shared_ptr<libta::Request<double>> req = std::make_shared<libta::Request<double>>();
+	req->reserve(n_estimation);
+	EXPECT_GE(req->capacity(), (size_t)n_estimation);
+	for (double v : samples) {
+	    req->add_value(v);
+	}
+
+	// The same request, built in bulk
+	libta::Request<double> from_range(samples.cbegin(), samples.cend());
+	libta::Request<double> from_array(samples.data(), samples.size());
+	libta::Request<double> appended;
+	appended.add_values(samples.data(), n_estimation / 2);
+	appended.add_values(samples.cbegin() + n_estimation / 2, samples.cend());
+	EXPECT_EQ(from_range.get_all(), req->get_all());
+	EXPECT_EQ(from_array.get_all(), req->get_all());
+	EXPECT_EQ(appended.get_all(), req->get_all());
+
+	// Adopting a vector does not copy it
+	std::vector<double> adopted_samples(samples);
+	const double *data = adopted_samples.data();
+	libta::Request<double> adopted(std::move(adopted_samples));
+	EXPECT_EQ(adopted.get_all().data(), data);
+	EXPECT_EQ(adopted.size(), (size_t)n_estimation);
+
+	libta::BSCTimingAnalyzer<double> mta;
+	EXPECT_EQ(mta.analyze(adopted).get_parameters(), mta.analyze(*req).get_parameters());
+
+	std::vector<double> released = adopted.release_values();
+	EXPECT_EQ(released.data(), data);
+	EXPECT_EQ(adopted.size(), 0u);
+}
+
+TEST(distribution_test, test_envelope)
+{
+	const int n_estimation=1000;  // number of experiments
+
+	std::default_random_engine generator;
+	std::vector<std::shared_ptr<libta::ResponseEVTDistribution>> modes;
+
+	for (double mean : {30., 50., 40.}) {
+		std::normal_distribution<double> distribution(mean, mean / 10);
+		std::shared_ptr<libta::Request<double>> req = std::make_shared<libta::Request<double>>();
+		for (int i=0; i<n_estimation; i++) {
+		    req->add_value(distribution(generator));
+		}
+		libta::BSCTimingAnalyzer<double> mta;
+		modes.push_back(std::dynamic_pointer_cast<libta::ResponseEVTDistribution>(mta.perform_analysis(req)));
+	}
+
+	// A GEV component, dominating only at small exceedance probabilities
+	auto gev = std::make_shared<libta::ResponseEVTDistribution>(libta::distribution_type_t::EVT_GEV);
+	gev->set_parameters(45, 1, 0.2);
+	modes.push_back(gev);
+
+	auto env = libta::make_envelope(modes);
+	ASSERT_EQ(env->size(), modes.size());
+
+	const double probs[] = {0.9, 0.999, 1 - 1e-6, 1 - 1e-9};
+	double quantiles[4];
+	env->get_quantiles(probs, quantiles, 4);
+
+	for (int j=0; j<4; j++) {
+		double expected = 0;
+		for (const auto &m : modes) {
+			expected = std::max(expected, m->get_quantile(probs[j]));
+		}
+		EXPECT_NEAR(quantiles[j], expected, 1e-9 * expected);
+		EXPECT_NEAR(modes[env->get_dominant(probs[j])]->get_quantile(probs[j]), expected, 1e-9 * expected);
+	}
+
+	EXPECT_THROW(env->get_quantile(1.), std::invalid_argument);
+}
+
+TEST(distribution_test, test_convolution)
+{
+	// The sum of two exponentials with unit rate has P(X > x) = (1 + x) exp(-x)
+	auto expon = std::make_shared<libta::ResponseEVTDistribution>(libta::distribution_type_t::EVT_GPD_2PARAM);
+	expon->set_parameters(0, 1, 0);
+
+	const double step = 1e-3;
+	libta::DiscreteDistribution chain = libta::convolve({expon, expon}, step);
+	EXPECT_LE(chain.get_overflow(), 2e-15);
+
+	for (double x : {1., 5., 10., 20.}) {
+		const double exact = (1 + x) * std::exp(-x);
+		EXPECT_GE(chain.get_exceedance(x), exact * (1 - 1e-6));
+		EXPECT_NEAR(chain.get_exceedance(x), exact, exact * 0.05);
+
+		// Quantiles are safe upper bounds, within a few grid steps
+		const double q = chain.get_quantile(1 - exact);
+		EXPECT_GE(q, x - step);
+		EXPECT_LE(q, x + 20 * step);
+	}
+
+	// Much less pessimistic than the sum of the quantiles
+	const double p = 1 - 1e-9;
+	EXPECT_LT(chain.get_quantile(p), 2 * expon->get_quantile(p) * 0.6);
+
+	// FFT and direct convolution agree
+	libta::DiscreteDistribution coarse(*expon, 0.5, 40);
+	libta::DiscreteDistribution fine(*expon, 0.5, 200);
+	libta::DiscreteDistribution fft = libta::convolve(fine, fine);
+	libta::DiscreteDistribution direct = libta::convolve(coarse, fine);
+	for (size_t k=0; k<40; k++) {
+		EXPECT_NEAR(fft.get_pmf()[k], direct.get_pmf()[k], 1e-12);
+	}
+
+	// Truncating the grid moves the mass to the overflow, and beyond it nothing is guaranteed
+	libta::DiscreteDistribution truncated = libta::convolve(fine, fine, 50);
+	EXPECT_EQ(truncated.get_bins(), 50u);
+	EXPECT_GT(truncated.get_overflow(), 1e-12);
+	EXPECT_TRUE(std::isinf(truncated.get_quantile(1 - truncated.get_overflow() / 2)));
+}
+
+TEST(distribution_test, test_convolution_deep_tail)
+{
+	// The sum of four exponentials with unit rate is Erlang: P(X > x) = exp(-x) sum_k x^k / k!
+	auto expon = std::make_shared<libta::ResponseEVTDistribution>(libta::distribution_type_t::EVT_GPD_2PARAM);
+	expon->set_parameters(0, 1, 0);
+	const auto erlang = [](double x) { return std::exp(-x) * (1 + x + x * x / 2 + x * x * x / 6); };
+
+	for (double step : {1e-2, 1e-3}) {
+		libta::DiscreteDistribution chain = libta::convolve({expon, expon, expon, expon}, step);
+		EXPECT_LE(chain.get_overflow(), 4e-18);
+
+		for (double p : {1e-6, 1e-9, 1e-12, 1e-14, 1e-15}) {
+			// The exceedance actually requested, i.e. 1 - (1 - p) rounded
+			const double exceedance = 1 - (1 - p);
+			double low = 0, high = 100;
+			for (int i=0; i<200; i++) {
+				const double mid = (low + high) / 2;
+				(erlang(mid) > exceedance ? low : high) = mid;
+			}
+
+			// Safe, and within the rounding of the four discretizations
+			const double q = chain.get_quantile(1 - p);
+			EXPECT_GE(q, high);
+			EXPECT_LE(q, high + 6 * step);
+		}
+	}
+}
+
+TEST(distribution_test, test_exceedance)
+{
+	using libta::distribution_type_t;
+
+	const double probs[] = {0.5, 0.9, 0.999, 1 - 1e-6, 1 - 1e-9, 1 - 1e-12};
+	const int n = sizeof(probs) / sizeof(probs[0]);
+
+	for (auto type : {distribution_type_t::EVT_GEV, distribution_type_t::EVT_GPD_2PARAM,
+	                  distribution_type_t::EVT_GPD_3PARAM}) {
+		for (double xi : {-0.2, 0., 0.3}) {
+			libta::ResponseEVTDistribution dist(type);
+			dist.set_parameters(100, 7, xi);
+
+			double budgets[n];
+			double exceedance[n];
+			for (int i=0; i<n; i++) {
+				budgets[i] = dist.get_quantile(probs[i]);
+			}
+			dist.get_exceedance(budgets, exceedance, n);
+
+			// The survival function is the inverse of the quantile
+			for (int i=0; i<n; i++) {
+				EXPECT_NEAR(exceedance[i], 1 - probs[i], (1 - probs[i]) * 1e-3)
+					<< "type " << (int)type << " xi " << xi << " p " << probs[i];
+				EXPECT_EQ(exceedance[i], dist.get_exceedance(budgets[i]));
+			}
+		}
+	}
+
+	libta::ResponseEVTDistribution gpd(distribution_type_t::EVT_GPD_2PARAM);
+	gpd.set_parameters(100, 7, -0.5);
+	EXPECT_EQ(gpd.get_exceedance(50.), 1.);     // Below the threshold
+	EXPECT_EQ(gpd.get_exceedance(200.), 0.);    // Above the upper endpoint
+}
+
+TEST(distribution_test, test_schedulability)
+{
+	// Almost deterministic execution times: the classic response time analysis applies
+	auto make_task = [](double wcet) {
+		auto dist = std::make_shared<libta::ResponseEVTDistribution>(libta::distribution_type_t::EVT_GPD_2PARAM);
+		dist->set_parameters(wcet, 0.01, 0);
+		return dist;
+	};
+
+	libta::TaskSet set(0.01, 20);
+	set.add_task(1, make_task(2), 5, 10);
+	EXPECT_LT(set.get_deadline_miss_probability(1), 1e-9);
+
+	// R = 2 + 4 > 5, so the second job of task 1 preempts it: R = 8
+	set.add_task(2, make_task(4), 20, 5, 7);
+	EXPECT_GT(set.get_deadline_miss_probability(2), 1 - 1e-9);
+	EXPECT_FALSE(set.is_schedulable(1e-6));
+	EXPECT_NEAR(set.get_response_time(2).get_quantile(0.5), 8, 0.1);
+
+	set.remove_task(2);
+	set.add_task(2, make_task(4), 20, 5, 9);
+	EXPECT_LT(set.get_deadline_miss_probability(2), 1e-9);
+	EXPECT_TRUE(set.is_schedulable(1e-6));
+
+	// Adding a lower priority task does not recompute the higher priority ones
+	const size_t before = set.get_analysis_count();
+	set.add_task(3, make_task(1), 20, 1);
+	set.get_deadline_miss_probability(1);
+	set.get_deadline_miss_probability(2);
+	EXPECT_EQ(set.get_analysis_count(), before);
+	set.get_deadline_miss_probability(3);
+	EXPECT_EQ(set.get_analysis_count(), before + 1);
+
+	// With exponential tails the miss probability grows with the interference
+	auto expon = std::make_shared<libta::ResponseEVTDistribution>(libta::distribution_type_t::EVT_GPD_2PARAM);
+	expon->set_parameters(1, 0.5, 0);
+	libta::TaskSet alone(0.01, 20);
+	alone.add_task(1, expon, 10, 1);
+	libta::TaskSet loaded(0.01, 20);
+	loaded.add_task(1, expon, 10, 1);
+	loaded.add_task(2, expon, 4, 2);
+	EXPECT_NEAR(alone.get_deadline_miss_probability(1), expon->get_exceedance(10.), 1e-6);
+	EXPECT_GT(loaded.get_deadline_miss_probability(1), alone.get_deadline_miss_probability(1));
+
+	EXPECT_THROW(set.add_task(4, make_task(1), 20, 10), std::invalid_argument);
+
+	// The backlog of the previous jobs of a task is not modelled
+	EXPECT_THROW(set.add_task(4, make_task(1), 10, 0, 15), std::invalid_argument);
+
+	// Without further releases of the higher priority task the response time is the sum of two
+	// unit exponentials: P(R > D) = (1 + D) exp(-D), down to the deep tail
+	auto unit = std::make_shared<libta::ResponseEVTDistribution>(libta::distribution_type_t::EVT_GPD_2PARAM);
+	unit->set_parameters(0, 1, 0);
+	for (double deadline : {20., 28., 34.}) {
+		libta::TaskSet pair(0.01, 40);
+		pair.add_task(1, unit, 40, 2);
+		pair.add_task(2, unit, 40, 1, deadline);
+		const double exact = (1 + deadline) * std::exp(-deadline);
+		EXPECT_GE(pair.get_deadline_miss_probability(2), exact);
+		EXPECT_LE(pair.get_deadline_miss_probability(2), exact * 1.05);
+	}
+}
+
+TEST(distribution_test, test_analysis_stats)
+{
+	const int n_estimation=2000;  // number of experiments
+
+	std::default_random_engine generator;
+	std::normal_distribution<double> distribution(40,3.0);
+
+	std::shared_ptr<libta::Request<double>> req = std::make_shared<libta::Request<double>>();
+
+	for (int i=0; i<n_estimation; i++) {
+	    req->add_value(distribution(generator));
+	}
+
+	libta::BSCTimingAnalyzer<double> mta(1000);
+	libta::BSCWorkspace<double> ws;
+
+	const libta::AnalysisStats before = libta::thread_stats();
+	mta.perform_analysis(*req, ws);
+
+	const libta::AnalysisStats &stats = ws.get_stats();
+	EXPECT_EQ(stats.analyses, 1u);
+	EXPECT_EQ(stats.samples, (uint64_t)n_estimation);
+	EXPECT_GE(stats.nelems, 10u);
+	EXPECT_GE(stats.bytes_allocated, (n_estimation + 4 * 1000) * sizeof(double));
+#ifdef LIBTA_STATS
+	EXPECT_GT(stats.get_time_ns(libta::phase_t::CV_SCAN), 0u);
+	EXPECT_EQ(stats.get_time_ns(libta::phase_t::RESPONSE), 0u);
+#else
+	EXPECT_EQ(stats.get_total_time_ns(), 0u);
+#endif
+
+	// Steady state: nothing allocated
+	mta.perform_analysis(*req, ws);
+	EXPECT_EQ(ws.get_stats().bytes_allocated, 0u);
+
+	EXPECT_EQ(libta::thread_stats().analyses, before.analyses + 2);
+	EXPECT_EQ(libta::thread_stats().samples, before.samples + 2 * n_estimation);
+}
+
+TEST(distribution_test, test_perf_counters)
+{
+	std::default_random_engine generator;
+	std::normal_distribution<double> distribution(40,3.0);
+
+	libta::Request<double> req;
+	for (int i=0; i<5000; i++) {
+	    req.add_value(distribution(generator));
+	}
+
+	libta::BSCTimingAnalyzer<double> mta(1000);
+	libta::BSCWorkspace<double> ws;
+	mta.perform_analysis(req, ws);
+
+	const libta::AnalysisStats &stats = ws.get_stats();
+	if (stats.counted == 0) {
+		// Counters not permitted or not compiled in: nothing is reported
+		EXPECT_EQ(stats.get_total_counter(libta::counter_t::CYCLES), 0u);
+		EXPECT_EQ(stats.get_total_counter(libta::counter_t::INSTRUCTIONS), 0u);
+		return;
+	}
+
+	EXPECT_TRUE(libta::PerfCounters::get().available());
+	EXPECT_GT(stats.get_counter(libta::phase_t::SORT, libta::counter_t::INSTRUCTIONS), 0u);
+	EXPECT_GT(stats.get_total_counter(libta::counter_t::CYCLES), 0u);
+}
+
+TEST(distribution_test, test_decimation)
+{
+	const int n_estimation=200000;  // number of experiments
+
+	std::default_random_engine generator;
+	std::lognormal_distribution<double> distribution(3.0,0.8);
+
+	libta::Request<double> req;
+	for (int i=0; i<n_estimation; i++) {
+	    req.add_value(distribution(generator));
+	}
+
+	libta::BSCTimingAnalyzer<double> mta(1000);
+	libta::BSCWorkspace<double> full, decimated;
+	mta.perform_analysis(req, full);
+
+	// A tiny initial tail forces the selection to be enlarged, but the result does not change
+	libta::DecimationReport report;
+	mta.perform_decimated_analysis(req, decimated, 16, report);
+	EXPECT_EQ(decimated.get_result().get_parameters(), full.get_result().get_parameters());
+	EXPECT_EQ(report.input_samples, (size_t)n_estimation);
+	EXPECT_EQ(report.nelems, full.get_stats().nelems);
+	EXPECT_TRUE(report.saturated);
+	EXPECT_GT(report.rounds, 1);
+	EXPECT_GT(report.tail_samples, report.nelems + 1);
+	EXPECT_LT(report.tail_samples, (size_t)n_estimation / 2);
+
+	// A large enough tail needs a single scan
+	mta.perform_decimated_analysis(req, decimated, report.tail_samples, report);
+	EXPECT_FALSE(report.saturated);
+	EXPECT_EQ(report.rounds, 1);
+	EXPECT_EQ(decimated.get_result().get_parameters(), full.get_result().get_parameters());
+
+	// The decimated trace keeps the whole tail and a stratified sample of the body
+	libta::DecimationReport dreport;
+	const size_t tail = report.tail_samples;
+	libta::Request<double> reduced = libta::decimate(req, tail, 1000, &dreport);
+	EXPECT_EQ(reduced.get_all().size(), tail + 1000);
+	EXPECT_EQ(dreport.tail_samples, tail);
+	EXPECT_EQ(dreport.body_samples, 1000u);
+	EXPECT_EQ(dreport.pre_threshold, report.pre_threshold);
+	EXPECT_EQ(std::count_if(reduced.cbegin(), reduced.cend(),
+	                        [&](double v) { return v >= dreport.pre_threshold; }), (long)tail);
+	EXPECT_EQ(*std::max_element(reduced.cbegin(), reduced.cend()),
+	          *std::max_element(req.cbegin(), req.cend()));
+}
+
+TEST(distribution_test, test_change_detection)
+{
+	std::default_random_engine generator;
+	std::normal_distribution<double> distribution(40,3.0);
+	std::normal_distribution<double> shifted(45,3.0);
+	std::normal_distribution<double> spread(40,6.0);
+
+	std::shared_ptr<libta::Request<double>> req = std::make_shared<libta::Request<double>>();
+	for (int i=0; i<5000; i++) {
+	    req->add_value(distribution(generator));
+	}
+
+	libta::BSCTimingAnalyzer<double> mta(1000);
+	auto dist = std::static_pointer_cast<libta::ResponseEVTDistribution>(mta.perform_analysis(req));
+
+	libta::ChangeDetector<double> detector(1.0, 50.);
+	detector.set_reference(*dist, 1e-2);
+
+	// Stationary behaviour: no re-estimation needed
+	EXPECT_FALSE(detector.update(*req));
+	for (int i=0; i<20000; i++) {
+	    req->add_value(distribution(generator));
+	}
+	EXPECT_FALSE(detector.update(*req));
+	EXPECT_EQ(detector.get_count(), 25000u);
+
+	// Shift of the mean
+	for (int i=0; i<200; i++) {
+	    req->add_value(shifted(generator));
+	}
+	EXPECT_TRUE(detector.update(*req));
+	EXPECT_TRUE(detector.is_mean_shift());
+
+	detector.reset();
+	EXPECT_FALSE(detector.is_changed());
+	EXPECT_EQ(detector.get_exceedances(), 0u);
+
+	// Same mean, heavier tail: only the exceedance-rate test notices
+	libta::ChangeDetector<double> tail_detector(1.0, 200.);
+	tail_detector.set_reference(*dist, 1e-2);
+	for (int i=0; i<2000; i++) {
+	    tail_detector.add_value(spread(generator));
+	}
+	EXPECT_TRUE(tail_detector.is_exceedance_excess());
+	EXPECT_FALSE(tail_detector.is_mean_shift());
+	EXPECT_TRUE(tail_detector.is_changed());
+
+	// A request trimmed to a window of its most recent values, as the AnalysisService does
+	libta::ChangeDetector<double> window_detector(1.0, 50.);
+	window_detector.set_reference(*dist, 1e-2);
+	libta::Request<double> window;
+	for (int round=0; round<10; round++) {
+	    for (int i=0; i<1000; i++) {
+	        window.add_value(distribution(generator));
+	    }
+	    window.discard_oldest(window.size() > 1500 ? window.size() - 1500 : 0);
+	    window_detector.update(window);
+	}
+	EXPECT_EQ(window.size(), 1500u);
+	EXPECT_EQ(window.get_appended(), 10000u);
+	EXPECT_EQ(window_detector.get_count(), 10000u);
+	EXPECT_FALSE(window_detector.is_changed());
+	for (int i=0; i<200; i++) {
+	    window.add_value(shifted(generator));
+	}
+	window.discard_oldest(200);
+	EXPECT_TRUE(window_detector.update(window));
+	EXPECT_EQ(window_detector.get_count(), 10200u);
+
+	// A request cleared and refilled beyond the samples already observed
+	window_detector.reset();
+	window.release_values();
+	for (int i=0; i<2000; i++) {
+	    window.add_value(distribution(generator));
+	}
+	window_detector.update(window);
+	EXPECT_EQ(window_detector.get_count(), 2000u);
+}
+
+TEST(distribution_test, test_tail_summary)
+{
+	const int n_estimation=40000;  // number of experiments
+	const size_t k=1000;
+
+	std::default_random_engine generator;
+	std::lognormal_distribution<double> distribution(3.0,0.8);
+
+	libta::Request<double> req;
+	for (int i=0; i<n_estimation; i++) {
+	    req.add_value(distribution(generator));
+	}
+
+	// One summary per "core"
+	std::vector<libta::TailSummary<double>> parts(4, libta::TailSummary<double>(k));
+	for (int i=0; i<n_estimation; i++) {
+	    parts[i % 4].add_value(req.get_all()[i]);
+	}
+
+	libta::TailSummary<double> left(k), right(k);
+	left.merge(parts[0]).merge(parts[1]);
+	left.merge(right.merge(parts[2]).merge(parts[3]));
+
+	libta::TailSummary<double> other(k);
+	other.merge(parts[3]).merge(parts[1]).merge(parts[0]).merge(parts[2]);
+
+	std::vector<double> top_left, top_other;
+	left.get_top(top_left);
+	other.get_top(top_other);
+	EXPECT_EQ(top_left, top_other);
+	EXPECT_EQ(left.get_count(), (uint64_t)n_estimation);
+	EXPECT_EQ(left.get_body_count(), (uint64_t)(n_estimation - k));
+	EXPECT_NEAR(left.get_body_mean(), other.get_body_mean(), 1e-9);
+	EXPECT_NEAR(left.get_body_variance(), other.get_body_variance(), 1e-6);
+
+	std::vector<double> sorted(req.cbegin(), req.cend());
+	std::sort(sorted.begin(), sorted.end(), std::greater<double>());
+	EXPECT_TRUE(std::equal(top_left.cbegin(), top_left.cend(), sorted.cbegin()));
+	const double body_mean = std::accumulate(sorted.cbegin() + k, sorted.cend(), 0.) / (n_estimation - k);
+	EXPECT_NEAR(left.get_body_mean(), body_mean, 1e-9);
+
+	// Round trip through bytes
+	const std::vector<uint8_t> bytes = left.serialize();
+	EXPECT_EQ(bytes.size(), 48 + 8 * k);
+	libta::TailSummary<double> restored(1);
+	ASSERT_TRUE(libta::TailSummary<double>::deserialize(bytes.data(), bytes.size(), restored));
+	EXPECT_EQ(restored.get_k(), k);
+	EXPECT_EQ(restored.get_count(), left.get_count());
+	std::vector<double> top_restored;
+	restored.get_top(top_restored);
+	EXPECT_EQ(top_restored, top_left);
+	EXPECT_FALSE(libta::TailSummary<double>::deserialize(bytes.data(), bytes.size() - 1, restored));
+
+	// Corrupted sizes are rejected before allocating anything
+	std::vector<uint8_t> corrupted = bytes;
+	corrupted[8 + 7] = 0x7f;    // k
+	EXPECT_FALSE(libta::TailSummary<double>::deserialize(corrupted.data(), corrupted.size(), restored));
+	corrupted = bytes;
+	libta::serial::put_u64(corrupted.data() + 8, 1u << 29);     // k
+	libta::serial::put_u64(corrupted.data() + 40, 1u << 29);    // top_size, beyond the buffer
+	EXPECT_FALSE(libta::TailSummary<double>::deserialize(corrupted.data(), corrupted.size(), restored));
+	EXPECT_EQ(restored.get_count(), left.get_count());
+	EXPECT_THROW(libta::TailSummary<double>(libta::TailSummary<double>::MAX_K + 1), std::invalid_argument);
+
+	// A body below a top-k that is not full is inconsistent
+	corrupted = bytes;
+	libta::serial::put_u64(corrupted.data() + 40, k - 1);     // top_size
+	EXPECT_FALSE(libta::TailSummary<double>::deserialize(corrupted.data(), corrupted.size(), restored));
+
+	// Integer samples round trip exactly, also above 2^53, and need a summary of integers
+	libta::TailSummary<uint64_t> cycles(4);
+	for (uint64_t i=0; i<10; i++) {
+		cycles.add_value((uint64_t(1) << 60) + 2 * i + 1);
+	}
+	const std::vector<uint8_t> cycle_bytes = cycles.serialize();
+	libta::TailSummary<uint64_t> cycles_restored(1);
+	ASSERT_TRUE(libta::TailSummary<uint64_t>::deserialize(cycle_bytes.data(), cycle_bytes.size(),
+	                                                      cycles_restored));
+	std::vector<uint64_t> top_cycles, top_cycles_restored;
+	cycles.get_top(top_cycles);
+	cycles_restored.get_top(top_cycles_restored);
+	EXPECT_EQ(top_cycles_restored, top_cycles);
+	EXPECT_EQ(top_cycles.front(), (uint64_t(1) << 60) + 19);
+	EXPECT_FALSE(libta::TailSummary<double>::deserialize(cycle_bytes.data(), cycle_bytes.size(),
+	                                                     restored));
+	libta::TailSummary<int64_t> signed_restored(1);
+	EXPECT_FALSE(libta::TailSummary<int64_t>::deserialize(cycle_bytes.data(), cycle_bytes.size(),
+	                                                      signed_restored));
+
+	// The analysis of the summary matches the one of the whole trace
+	libta::BSCTimingAnalyzer<double> mta(1000);
+	libta::BSCWorkspace<double> full, summarized;
+	mta.perform_analysis(req, full);
+	mta.perform_analysis(restored, summarized);
+	EXPECT_EQ(summarized.get_result().get_parameters(), full.get_result().get_parameters());
+	EXPECT_TRUE(summarized.get_result().is_complete());
+	EXPECT_EQ(summarized.get_result().get_total_samples(), (size_t)n_estimation);
+
+	// A too small summary gives a safe, incomplete estimate
+	libta::TailSummary<double> small(20);
+	small.add_values(req);
+	mta.perform_analysis(small, summarized);
+	EXPECT_FALSE(summarized.get_result().is_complete());
+	EXPECT_GE(summarized.get_result().get_sigma(), summarized.get_low_gpd().get_sigma());
+	for (double p : {1e-3, 1e-9, 1e-12}) {
+		EXPECT_GE(summarized.get_result().get_quantile(1 - p), full.get_result().get_quantile(1 - p));
+		EXPECT_GE(summarized.get_result().get_quantile(1 - p), full.get_high_gpd().get_quantile(1 - p));
+	}
+}
+
+TEST(distribution_test, test_analysis_service)
+{
+	const std::string name = "/libta-test-" + std::to_string(getpid());
+
+	auto mta = std::make_shared<libta::BSCTimingAnalyzer<double>>(1000);
+	libta::AnalysisService<double> service(mta, 2000);
+	service.add_task(7, name, 4096);
+
+	std::vector<int> published;
+	service.set_publisher([&published](int id, std::shared_ptr<libta::Response>) {
+		published.push_back(id);
+	});
+
+	// The samples are pushed by another process
+	const pid_t pid = fork();
+	ASSERT_GE(pid, 0);
+	if (pid == 0) {
+		std::default_random_engine generator;
+		std::normal_distribution<double> distribution(40,3.0);
+		libta::SampleProducer<double> producer(name);
+		int pushed = 0;
+		while (pushed < 3000) {
+			// Wait for the service when the ring is full
+			if (producer.push(distribution(generator))) {
+				pushed++;
+			} else {
+				usleep(100);
+			}
+		}
+		_exit(0);
+	}
+
+	// Drain while the child is running, the ring is smaller than the samples produced
+	int status;
+	while (waitpid(pid, &status, WNOHANG) == 0) {
+		service.poll_once();
+		usleep(100);
+	}
+	ASSERT_TRUE(WIFEXITED(status));
+	EXPECT_EQ(WEXITSTATUS(status), 0);
+	service.poll_once();
+
+	EXPECT_EQ(service.get_samples(7), 3000u);
+	EXPECT_EQ(published.size(), 1u);
+	auto result = std::static_pointer_cast<libta::ResponseEVTDistribution>(service.get_result(7));
+	ASSERT_TRUE(result != nullptr);
+	EXPECT_GT(result->get_quantile(1 - 1e-9), 40.);
+
+	// In-process producer: the ring drops the samples when full
+	libta::SampleProducer<double> producer(name);
+	for (int i=0; i<5000; i++) {
+		producer.push(40.);
+	}
+	EXPECT_EQ(service.get_dropped(7), 5000u - 4096u);
+	EXPECT_EQ(producer.get_pending(), 4096u);
+	service.poll_once();
+	EXPECT_EQ(service.get_samples(7), 3000u + 4096u);
+	EXPECT_EQ(published.size(), 2u);
+
+	// A producer moving the head more than one capacity ahead corrupts the ring: the pending
+	// samples are discarded instead of read past the end of the ring
+	size_t mapped;
+	void *raw = libta::shm::map_object(name, 0, libta::shm::data_offset(), mapped);
+	auto *header = static_cast<libta::shm::RingHeader*>(raw);
+	header->head.store(header->tail.load() + 10 * 4096);
+	EXPECT_EQ(service.poll_once(), 0u);
+	EXPECT_EQ(service.get_corruptions(7), 1u);
+	EXPECT_EQ(service.get_samples(7), 3000u + 4096u);
+	EXPECT_EQ(producer.get_pending(), 0u);
+	EXPECT_TRUE(producer.push(40.));
+	service.poll_once();
+	EXPECT_EQ(service.get_samples(7), 3000u + 4096u + 1u);
+	EXPECT_EQ(service.get_corruptions(7), 1u);
+	munmap(raw, mapped);
+
+	service.remove_task(7);
+	EXPECT_THROW(libta::SampleProducer<double> missing(name), std::runtime_error);
+}
+
+TEST(distribution_test, test_analysis_service_bounded)
+{
+	const std::string name = "/libta-bounded-" + std::to_string(getpid());
+
+	auto mta = std::make_shared<libta::BSCTimingAnalyzer<double>>(1000);
+	libta::AnalysisService<double> service(mta, 1000, 1500);
+	service.add_task(2, name, 8192);
+
+	// Only the most recent max_samples samples are kept, also within a single drain
+	std::default_random_engine generator;
+	std::normal_distribution<double> distribution(40,3.0);
+	libta::SampleProducer<double> producer(name);
+	for (int i=0; i<8192; i++) {
+		producer.push(distribution(generator));
+	}
+	EXPECT_EQ(service.poll_once(), 1u);
+	EXPECT_EQ(service.get_samples(2), 1500u);
+	EXPECT_EQ(producer.get_pending(), 0u);
+
+	for (int i=0; i<100; i++) {
+		producer.push(distribution(generator));
+	}
+	EXPECT_EQ(service.poll_once(), 0u);
+	EXPECT_EQ(service.get_samples(2), 1500u);
+
+	service.remove_task(2);
+}
+
+TEST(distribution_test, test_distribution_registry)
+{
+	const std::string name = "/libta-registry-" + std::to_string(getpid());
+	const std::string ring = "/libta-ring-" + std::to_string(getpid());
+
+	auto registry = std::make_shared<libta::DistributionRegistry>(name, 16);
+	libta::DistributionRegistry reader(name);
+	EXPECT_EQ(reader.get_slots(), 16u);
+	EXPECT_TRUE(reader.get(3) == nullptr);
+	EXPECT_EQ(reader.get_version(3), 0u);
+	EXPECT_THROW(reader.publish(3, libta::distribution_type_t::EVT_GEV,
+	                            std::make_tuple(1., 1., 0., 0.)), std::logic_error);
+
+	// The service publishes its results
+	auto mta = std::make_shared<libta::BSCTimingAnalyzer<double>>(1000);
+	libta::AnalysisService<double> service(mta, 1000);
+	service.set_registry(registry);
+	service.add_task(3, ring, 2048);
+
+	std::default_random_engine generator;
+	std::normal_distribution<double> distribution(40,3.0);
+	libta::SampleProducer<double> producer(ring);
+	for (int i=0; i<1500; i++) {
+		producer.push(distribution(generator));
+	}
+	EXPECT_EQ(service.poll_once(), 1u);
+
+	libta::distribution_type_t type;
+	libta::DistributionRegistry::parameters_t params;
+	uint64_t version;
+	ASSERT_TRUE(reader.lookup(3, type, params, &version));
+	EXPECT_EQ(version, 1u);
+	auto result = std::static_pointer_cast<libta::ResponseEVTDistribution>(service.get_result(3));
+	EXPECT_EQ(type, result->get_dist_type());
+	EXPECT_EQ(params, result->get_parameters());
+
+	// Readers always see a consistent snapshot while the writer keeps publishing
+	std::atomic<bool> stop(false);
+	std::atomic<int> torn(0);
+	std::thread checker([&]() {
+		libta::distribution_type_t t;
+		libta::DistributionRegistry::parameters_t p;
+		while (! stop) {
+			if (reader.lookup(5, t, p)) {
+				const double mu = std::get<libta::ResponseEVTDistribution::P_MU>(p);
+				if (std::get<libta::ResponseEVTDistribution::P_SIGMA>(p) != 2 * mu
+				    || std::get<libta::ResponseEVTDistribution::P_THRSH>(p) != 3 * mu) {
+					torn++;
+				}
+			}
+		}
+	});
+	for (int i=1; i<=100000; i++) {
+		registry->publish(5, libta::distribution_type_t::EVT_GPD_2PARAM,
+		                  std::make_tuple(double(i), 2. * i, 0., 3. * i));
+	}
+	stop = true;
+	checker.join();
+	EXPECT_EQ(torn, 0);
+	EXPECT_EQ(reader.get_version(5), 100000u);
+	EXPECT_EQ(reader.get(5)->get_mu(), 100000.);
+
+	// Different tasks use different slots, until the registry is full
+	for (int id=100; id<114; id++) {
+		EXPECT_TRUE(registry->publish(id, *result));
+	}
+	EXPECT_FALSE(registry->publish(200, *result));
+	EXPECT_EQ(reader.get(3)->get_parameters(), result->get_parameters());
+	EXPECT_EQ(reader.get(113)->get_parameters(), result->get_parameters());
+
+	// The results the service cannot publish in a full registry are counted
+	const std::string full_ring = ring + "-full";
+	service.add_task(4, full_ring, 2048);
+	libta::SampleProducer<double> full_producer(full_ring);
+	for (int i=0; i<1500; i++) {
+		full_producer.push(distribution(generator));
+	}
+	EXPECT_EQ(service.poll_once(), 1u);
+	EXPECT_EQ(service.get_unpublished(4), 1u);
+	EXPECT_EQ(service.get_unpublished(3), 0u);
+	EXPECT_TRUE(reader.get(4) == nullptr);
+
+	// A registry without slots is rejected by the readers
+	size_t mapped;
+	void *raw = libta::shm::map_object(name, 0, libta::shm::registry_size(0), mapped);
+	auto *header = static_cast<libta::shm::RegistryHeader*>(raw);
+	const uint64_t slots = header->slots;
+	header->slots = 0;
+	EXPECT_THROW(libta::DistributionRegistry zero(name), std::runtime_error);
+	header->slots = slots;
+	munmap(raw, mapped);
+}
+
+TEST(distribution_test, test_c_api)
+{
+	const int n_estimation=2000;  // number of experiments
+
+	std::default_random_engine generator;
+	std::normal_distribution<double> distribution(40000,300.0);
+
+	std::vector<uint64_t> samples;
+	std::vector<double> dsamples;
+	for (int i=0; i<n_estimation; i++) {
+	    samples.push_back(static_cast<uint64_t>(distribution(generator)));
+	    dsamples.push_back(static_cast<double>(samples.back()));
+	}
+
+	libta_analyzer_t *analyzer = nullptr;
+	libta_workspace_t *ws = nullptr;
+	ASSERT_EQ(libta_analyzer_create(LIBTA_SAMPLES_U64, 1000, &analyzer), LIBTA_OK);
+	ASSERT_EQ(libta_workspace_create(analyzer, n_estimation, &ws), LIBTA_OK);
+
+	// Pre-sized workspace: no allocation at all
+	libta_result_t result;
+	const size_t before = heap_allocations.load();
+	ASSERT_EQ(libta_analyze_u64(analyzer, ws, samples.data(), samples.size(), &result), LIBTA_OK);
+	EXPECT_EQ(heap_allocations.load(), before);
+
+	libta::BSCTimingAnalyzer<double> mta(1000);
+	libta::BSCWorkspace<double> cws;
+	mta.perform_analysis(samples.data(), samples.size(), cws);
+	EXPECT_EQ(result.dist_type, LIBTA_EVT_GPD_2PARAM);
+	EXPECT_EQ(result.params.mu, cws.get_result().get_mu());
+	EXPECT_EQ(result.params.sigma, cws.get_result().get_sigma());
+	EXPECT_EQ(result.high.sigma, cws.get_high_gpd().get_sigma());
+	EXPECT_EQ(result.low.sigma, cws.get_low_gpd().get_sigma());
+	EXPECT_EQ(result.samples, (uint64_t)n_estimation);
+	EXPECT_GE(result.tail_samples, 10u);
+
+	double q;
+	ASSERT_EQ(libta_quantile(result.dist_type, &result.params, 1 - 1e-9, &q), LIBTA_OK);
+	EXPECT_DOUBLE_EQ(q, cws.get_result().get_quantile(1 - 1e-9));
+	EXPECT_EQ(libta_quantile(result.dist_type, &result.params, 1., &q), LIBTA_E_INVALID_ARGUMENT);
+
+	// Errors are reported by code
+	EXPECT_EQ(libta_analyze_u64(analyzer, ws, samples.data(), 5, &result), LIBTA_E_INVALID_DATA);
+	EXPECT_EQ(libta_analyze_double(analyzer, ws, dsamples.data(), dsamples.size(), &result),
+	          LIBTA_E_INVALID_ARGUMENT);
+	EXPECT_EQ(libta_analyze_u64(analyzer, ws, nullptr, 100, &result), LIBTA_E_INVALID_ARGUMENT);
+	EXPECT_STREQ(libta_status_string(LIBTA_E_INVALID_DATA), "The samples do not allow the analysis");
+
+	libta_workspace_destroy(ws);
+	libta_analyzer_destroy(analyzer);
+
+	ASSERT_EQ(libta_analyzer_create(LIBTA_SAMPLES_DOUBLE, 1000, &analyzer), LIBTA_OK);
+	ASSERT_EQ(libta_workspace_create(analyzer, 0, &ws), LIBTA_OK);
+	libta_result_t dresult;
+	ASSERT_EQ(libta_analyze_double(analyzer, ws, dsamples.data(), dsamples.size(), &dresult), LIBTA_OK);
+	EXPECT_EQ(dresult.params.sigma, result.params.sigma);
+	libta_workspace_destroy(ws);
+	libta_analyzer_destroy(analyzer);
+}
+
+TEST(distribution_test, test_confidence_policy)
+{
+	static_assert(libta::BSCPolicy95::z > 1.95996 && libta::BSCPolicy95::z < 1.95997,
+	              "Wrong critical value");
+	static_assert(libta::bsc_limits<libta::BSCPolicy95>.half_width[4] == libta::BSCPolicy95::z / 2,
+	              "Wrong half-width");
+	EXPECT_NEAR((double)libta::BSCPolicy90::z, 1.644853627, 1e-9);
+	EXPECT_NEAR((double)libta::BSCPolicy99::z, 2.575829304, 1e-9);
+	EXPECT_NEAR((double)libta::bsc_limits<libta::BSCPolicy99>.get(5000),
+	            2.575829304 / std::sqrt(5000.), 1e-9);
+
+	std::default_random_engine generator;
+	std::lognormal_distribution<double> distribution(3.0,0.8);
+	libta::Request<double> req;
+	for (int i=0; i<200000; i++) {
+	    req.add_value(distribution(generator));
+	}
+
+	libta::BSCTimingAnalyzer<double> mta95(1000);
+	libta::BSCTimingAnalyzer<double, libta::BSCPolicy99> mta99(1000);
+	EXPECT_NE(mta95.get_configuration_hash(), mta99.get_configuration_hash());
+
+	libta::BSCWorkspace<double> ws95, ws99;
+	mta95.perform_analysis(req, ws95);
+	mta99.perform_analysis(req, ws99);
+
+	// A wider cone accepts a longer tail, and the rate bounds are wider
+	EXPECT_GE(ws99.get_stats().nelems, ws95.get_stats().nelems);
+	const double z95 = libta::BSCPolicy95::z / std::sqrt((double)ws95.get_stats().nelems);
+	const double z99 = libta::BSCPolicy99::z / std::sqrt((double)ws99.get_stats().nelems);
+	EXPECT_NEAR(ws95.get_low_gpd().get_sigma() / ws95.get_result().get_sigma(), 1 / (1 + z95), 1e-6);
+	EXPECT_NEAR(ws99.get_low_gpd().get_sigma() / ws99.get_result().get_sigma(), 1 / (1 + z99), 1e-6);
+}
+
+TEST(distribution_test, test_mixed_precision)
+{
+	std::default_random_engine generator;
+	std::lognormal_distribution<double> distribution(3.0,0.8);
+	libta::Request<long double> req;
+	for (int i=0; i<200000; i++) {
+	    req.add_value(std::round(distribution(generator) * 1000));
+	}
+
+	libta::BSCTimingAnalyzer<long double> native(1000);
+	libta::BSCTimingAnalyzer<long double> mixed(1000, libta::precision_t::MIXED);
+	EXPECT_NE(native.get_configuration_hash(), mixed.get_configuration_hash());
+
+	libta::BSCWorkspace<long double> ws_native, ws_mixed;
+	native.perform_analysis(req, ws_native);
+	mixed.perform_analysis(req, ws_mixed);
+
+	// Integer samples are exact in double: the same tail is selected and fitted in long double
+	EXPECT_EQ(ws_mixed.get_stats().nelems, ws_native.get_stats().nelems);
+	EXPECT_EQ(ws_mixed.get_stats().samples, ws_native.get_stats().samples);
+	EXPECT_EQ(ws_mixed.get_result().get_parameters(), ws_native.get_result().get_parameters());
+	EXPECT_EQ(ws_mixed.get_high_gpd().get_parameters(), ws_native.get_high_gpd().get_parameters());
+}
+
+TEST(distribution_test, test_summation_kernels)
+{
+	// A long float tail far from the threshold: the naive sum loses several digits
+	std::default_random_engine generator;
+	std::exponential_distribution<double> distribution(0.01);
+	std::vector<float> values;
+	for (int i=0; i<1000000; i++) {
+	    values.push_back(1e4f + (float)distribution(generator));
+	}
+	std::sort(values.begin(), values.end(), std::greater<float>());
+	values.push_back(1e4f);
+
+	long double exact = 0;
+	for (float v : values) {
+	    exact += (long double)v - 1e4L;
+	}
+	exact /= values.size();
+
+	const auto error = [&](libta::summation_t summation) {
+		return std::fabs((long double)libta::getUnbiasedMean(values, 0, values.size(), summation)
+		                 - exact) / exact;
+	};
+	const long double naive = error(libta::summation_t::NAIVE);
+	EXPECT_GT(naive, 1e-5L);
+	EXPECT_LT(error(libta::summation_t::KAHAN), 1e-6L);
+	EXPECT_LT(error(libta::summation_t::NEUMAIER), 1e-6L);
+	EXPECT_LT(error(libta::summation_t::PAIRWISE), 1e-6L);
+
+	// Selected per analyzer: the float analysis matches the double one
+	libta::Request<float> req_float;
+	libta::Request<double> req_double;
+	std::lognormal_distribution<double> lognormal(3.0,0.8);
+	for (int i=0; i<200000; i++) {
+	    const float v = (float)lognormal(generator);
+	    req_float.add_value(v);
+	    req_double.add_value(v);
+	}
+	libta::BSCTimingAnalyzer<float> mta_float(1000, libta::precision_t::NATIVE,
+	                                          libta::summation_t::NEUMAIER);
+	libta::BSCTimingAnalyzer<double> mta_double(1000);
+	libta::BSCWorkspace<float> ws_float;
+	libta::BSCWorkspace<double> ws_double;
+	mta_float.perform_analysis(req_float, ws_float);
+	mta_double.perform_analysis(req_double, ws_double);
+	EXPECT_EQ(ws_float.get_stats().nelems, ws_double.get_stats().nelems);
+	EXPECT_NEAR(ws_float.get_result().get_sigma() / ws_double.get_result().get_sigma(), 1, 1e-6);
+}
+
+TEST(distribution_test, test_partitioned_analysis)
+{
+	std::default_random_engine generator;
+	std::lognormal_distribution<double> fast(3.0,0.8), slow(4.0,0.8);
+
+	// Two contexts interleaved in a single buffer, plus a context with too few samples
+	libta::Request<double> req, req_fast, req_slow;
+	for (int i=0; i<50000; i++) {
+	    const double f = fast(generator), s = slow(generator);
+	    req.add_value(f, 1);
+	    req.add_value(s, 7);
+	    req_fast.add_value(f);
+	    req_slow.add_value(s);
+	}
+	for (int i=0; i<5; i++) {
+	    req.add_value(1000., 3);
+	}
+	EXPECT_TRUE(req.has_tags());
+	EXPECT_EQ(req.get_tags().size(), req.size());
+
+	libta::BSCTimingAnalyzer<double> mta(1000);
+	libta::PartitionedResult<double> result;
+	mta.perform_partitioned_analysis(req, result, true, 2);
+
+	ASSERT_EQ(result.partitions.size(), 3u);
+	EXPECT_EQ(result.partitions[0].tag, 1);
+	EXPECT_EQ(result.partitions[1].tag, 3);
+	EXPECT_EQ(result.partitions[2].tag, 7);
+	EXPECT_EQ(result.find(3)->samples, 5u);
+	EXPECT_TRUE(result.find(3)->result.is_error());
+	EXPECT_EQ(result.find(2), nullptr);
+
+	// Every partition is analyzed as its own request
+	libta::BSCWorkspace<double> ws;
+	mta.perform_analysis(req_fast, ws);
+	EXPECT_EQ(result.find(1)->result.get_parameters(), ws.get_result().get_parameters());
+	mta.perform_analysis(req_slow, ws);
+	EXPECT_EQ(result.find(7)->result.get_parameters(), ws.get_result().get_parameters());
+
+	// The envelope is dominated by the slow context
+	ASSERT_NE(result.envelope, nullptr);
+	ASSERT_EQ(result.envelope->size(), 2u);
+	EXPECT_DOUBLE_EQ(result.envelope->get_quantile(1 - 1e-9), ws.get_result().get_quantile(1 - 1e-9));
+
+	// Untagged values added to a tagged request get tag 0
+	req.add_value(1.);
+	EXPECT_EQ(req.get_tags().back(), 0);
+}
+
+TEST(distribution_test, test_partitioned_analysis_degenerate)
+{
+	libta::BSCTimingAnalyzer<double> mta(1000);
+	libta::PartitionedResult<double> result;
+
+	// An empty request has no partitions, with any number of workers
+	mta.perform_partitioned_analysis(libta::Request<double>(), result, true, 4);
+	EXPECT_TRUE(result.partitions.empty());
+	ASSERT_NE(result.envelope, nullptr);
+	EXPECT_EQ(result.envelope->size(), 0u);
+	mta.perform_partitioned_analysis(libta::Request<double>(), result, false, 0);
+	EXPECT_TRUE(result.partitions.empty());
+	EXPECT_EQ(result.envelope, nullptr);
+
+	// A single partition is analyzed by the calling thread only
+	std::default_random_engine generator;
+	std::lognormal_distribution<double> distribution(3.0,0.8);
+	libta::Request<double> req;
+	for (int i=0; i<20000; i++) {
+	    req.add_value(distribution(generator), 5);
+	}
+	mta.perform_partitioned_analysis(req, result, true, 4);
+	ASSERT_EQ(result.partitions.size(), 1u);
+	EXPECT_EQ(result.partitions[0].tag, 5);
+	EXPECT_EQ(result.partitions[0].samples, 20000u);
+	ASSERT_TRUE(result.partitions[0].result.is_distribution());
+
+	libta::BSCWorkspace<double> ws;
+	mta.perform_analysis(req, ws);
+	EXPECT_EQ(result.partitions[0].result.get_parameters(), ws.get_result().get_parameters());
+	ASSERT_NE(result.envelope, nullptr);
+	EXPECT_EQ(result.envelope->size(), 1u);
+}
+
+TEST(distribution_test, test_mrl_threshold)
+{
+	std::default_random_engine generator;
+	std::exponential_distribution<double> distribution(1. / 50);
+
+	// An exponential tail above 1000, with a couple of outliers on top
+	libta::Request<double> req;
+	for (int i=0; i<20000; i++) {
+	    req.add_value(1000. + distribution(generator));
+	}
+	req.add_value(3000.);
+	req.add_value(3100.);
+
+	libta::BSCTimingAnalyzer<double> cv(1000);
+	libta::BSCTimingAnalyzer<double> mrl(1000, libta::precision_t::NATIVE,
+	                                     libta::summation_t::NAIVE, libta::threshold_t::MRL);
+	EXPECT_NE(cv.get_configuration_hash(), mrl.get_configuration_hash());
+
+	// The outliers push the CV out of the cone immediately
+	libta::BSCWorkspace<double> ws;
+	EXPECT_THROW(cv.perform_analysis(req, ws), libta::TimingAnalyzerError);
+
+	// The outliers only make the mean excess decrease: the tail is fitted, conservatively
+	mrl.perform_analysis(req, ws);
+	EXPECT_GE(ws.get_stats().nelems, 10u);
+	EXPECT_GT(ws.get_result().get_sigma(), 50.);
+
+	// Same selection with the MIXED scan
+	libta::BSCTimingAnalyzer<double> mrl_mixed(1000, libta::precision_t::MIXED,
+	                                           libta::summation_t::NAIVE, libta::threshold_t::MRL);
+	libta::BSCWorkspace<double> ws_mixed;
+	mrl_mixed.perform_analysis(req, ws_mixed);
+	EXPECT_EQ(ws_mixed.get_stats().nelems, ws.get_stats().nelems);
+
+	// Without the outliers the mean excess is stable and estimates the exponential scale
+	std::vector<double> values = req.release_values();
+	values.resize(values.size() - 2);
+	req.set_values(std::move(values));
+	mrl.perform_analysis(req, ws);
+	EXPECT_GT(ws.get_stats().nelems, 100u);
+	EXPECT_NEAR(ws.get_result().get_sigma(), 50., 5.);
+}
@@ -0,0 +1,74 @@
+#include "gtest/gtest.h"
+
+#include "libta/libta.h"
+
+#include <memory>
+#include <random>
+
+using namespace libta;
+
+namespace {
+
+std::shared_ptr<Request<double>> make_request(size_t size, unsigned seed) {
+	std::mt19937 gen(seed);
+	std::exponential_distribution<double> dist(0.5);
+	auto req = std::make_shared<Request<double>>();
+	for(size_t i = 0; i < size; i++) {
+		req->add_value(100 + dist(gen));
+	}
+	return req;
+}
+
+// The first rank of the table whose exceedance probability does not exceed p
+double table_pwcet(const std::vector<double> &rank, const std::vector<double> &pwcet, double p) {
+	for(size_t i = 0; i < pwcet.size(); i++) {
+		if(pwcet[i] <= p)
+			return rank[i];
+	}
+	return rank.back();
+}
+
+}	// namespace
+
+TEST(include_distribution, closed_form_matches_table)
+{
+	DistributionAnalyzer<double> analyzer;
+	auto result = analyzer.estimate_distribution(make_request(20000, 1));
+	ASSERT_FALSE(result.isLeft);
+	auto dist = result.rightValue;
+
+	const auto table = dist->tabulate();
+	const double step = table.rank[1] - table.rank[0];
+	for(double p : {1e-3, 1e-6, 1e-9}) {
+		const auto pwcet = dist->getPWCET(p);
+		const auto low = dist->getPWCETLow(p);
+		const auto high = dist->getPWCETHigh(p);
+		ASSERT_FALSE(pwcet.isLeft || low.isLeft || high.isLeft);
+		EXPECT_NEAR(pwcet.rightValue.pWCET, table_pwcet(table.rank, table.pWCET, p), step);
+		EXPECT_NEAR(low.rightValue.pWCET, table_pwcet(table.rank, table.pWCETlow, p), step);
+		EXPECT_NEAR(high.rightValue.pWCET, table_pwcet(table.rank, table.pWCEThigh, p), step);
+		EXPECT_LE(low.rightValue.pWCET, pwcet.rightValue.pWCET);
+		EXPECT_LE(pwcet.rightValue.pWCET, high.rightValue.pWCET);
+	}
+}
+
+TEST(include_distribution, zero_probability_is_invalid)
+{
+	DistributionAnalyzer<double> analyzer;
+	auto result = analyzer.estimate_distribution(make_request(1000, 2));
+	ASSERT_FALSE(result.isLeft);
+	auto dist = result.rightValue;
+
+	EXPECT_TRUE(dist->getPWCET(0).isLeft);
+	EXPECT_TRUE(dist->getPWCETLow(0).isLeft);
+	EXPECT_TRUE(dist->getPWCETHigh(0).isLeft);
+	EXPECT_FALSE(dist->getPWCET(1e-300).isLeft);
+}
+
+TEST(include_distribution, too_few_samples)
+{
+	DistributionAnalyzer<double> analyzer;
+	EXPECT_TRUE(analyzer.estimate_distribution(make_request(0, 3)).isLeft);
+	EXPECT_TRUE(analyzer.estimate_distribution(make_request(10, 3)).isLeft);
+	EXPECT_FALSE(analyzer.estimate_distribution(make_request(1000, 1)).isLeft);
+}